@@ -6,6 +6,12 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+
+#if !defined(CCSV_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CCSV_X86
+#endif
 
 struct ccsv
 {
@@ -35,7 +41,7 @@ do { \
    ccsv - previously initialized ccsv structure
    type - output: '"' if the field was quoted
  */
-char *ccsv_nextfield(struct ccsv *ccsv, char *type)
+static inline char *ccsv_nextfield(struct ccsv *ccsv, char *type)
 {
   char *ret=(ccsv)->line;
   char *base=(ccsv)->line;
@@ -60,11 +66,161 @@ char *ccsv_nextfield(struct ccsv *ccsv, char *type)
     if(NULL==(ccsv)->line)
     {
       char *p=&ret[strlen(ret)-1];
-      if(sep!='"') while(isspace(*p)) --p;
+      if(sep!='"') while(p>=ret&&isspace(*p)) --p;
       *++p='\0';
     }
   }
   return(ret);
 }
 
+/* one field of a record split by ccsv_split()
+ */
+struct ccsv_field
+{
+  char *str;     /* first byte of the field value inside the record */
+  size_t len;    /* length of the value, quotes and surrounding spaces removed */
+  char type;     /* '"' if the field was quoted, the delimiter otherwise */
+};
+
+/* bitmask of the delimiters and quotes in 64 bytes, bit n is set for p[n]
+ */
+typedef uint64_t (*ccsv_maskfn)(const char *p, char delim);
+
+static inline uint64_t ccsv_mask_scalar(const char *p, char delim)
+{
+  uint64_t m=0;
+  int i;
+  for(i=0;i<64;i++) if(p[i]==delim||p[i]=='"') m|=(uint64_t)1<<i;
+  return(m);
+}
+
+#ifdef CCSV_X86
+__attribute__((target("sse2")))
+static inline uint64_t ccsv_mask_sse2(const char *p, char delim)
+{
+  const __m128i d=_mm_set1_epi8(delim);
+  const __m128i q=_mm_set1_epi8('"');
+  uint64_t m=0;
+  int i;
+  for(i=0;i<64;i+=16)
+  {
+    __m128i v=_mm_loadu_si128((const __m128i *)(p+i));
+    m|=(uint64_t)(uint16_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v,d),_mm_cmpeq_epi8(v,q)))<<i;
+  }
+  return(m);
+}
+
+__attribute__((target("avx2")))
+static inline uint64_t ccsv_mask_avx2(const char *p, char delim)
+{
+  const __m256i d=_mm256_set1_epi8(delim);
+  const __m256i q=_mm256_set1_epi8('"');
+  __m256i lo=_mm256_loadu_si256((const __m256i *)p);
+  __m256i hi=_mm256_loadu_si256((const __m256i *)(p+32));
+  uint32_t ml=(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(lo,d),_mm256_cmpeq_epi8(lo,q)));
+  uint32_t mh=(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(hi,d),_mm256_cmpeq_epi8(hi,q)));
+  return((uint64_t)mh<<32|ml);
+}
+#endif
+
+/* select the widest block scanner supported by the cpu
+ */
+static inline ccsv_maskfn ccsv_maskfn_get(void)
+{
+  static ccsv_maskfn fn=NULL;
+
+  if(NULL==fn)
+  {
+#ifdef CCSV_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) fn=ccsv_mask_avx2;
+    else if(__builtin_cpu_supports("sse2")) fn=ccsv_mask_sse2;
+    else
+#endif
+    fn=ccsv_mask_scalar;
+  }
+  return(fn);
+}
+
+/* iterator over the delimiters and quotes of a record
+ */
+struct ccsv_scan
+{
+  const char *line;
+  size_t len;
+  size_t off;    /* offset of the current 64 byte block */
+  uint64_t mask; /* unconsumed structural characters of the block */
+  char delim;
+  ccsv_maskfn fn;
+};
+
+/* returns the offset of the next delimiter or quote or len if there is none
+ */
+static inline size_t ccsv_scan_next(struct ccsv_scan *sc)
+{
+  size_t i;
+
+  while(0==sc->mask)
+  {
+    if((sc->off+=64)>=sc->len) return(sc->off=sc->len);
+    if(sc->len-sc->off>=64) sc->mask=sc->fn(&sc->line[sc->off],sc->delim);
+    else for(i=sc->off;i<sc->len;i++) if(sc->line[i]==sc->delim||sc->line[i]=='"') sc->mask|=(uint64_t)1<<(i-sc->off);
+  }
+  i=sc->off+__builtin_ctzll(sc->mask);
+  sc->mask&=sc->mask-1;
+  return(i);
+}
+
+#define CCSV_ISSPACE(_c) ((_c)==' '||((_c)>='\t'&&(_c)<='\r'))
+
+/* split one record of len bytes according to rfc4180 in one pass
+   the record is scanned 64 bytes at a time for delimiters and quotes and
+   only those positions are visited, the record is not modified
+   line   - the record without its line terminator
+   fld    - output: at most max fields
+   returns the number of fields stored
+ */
+static inline int ccsv_split(char *line, size_t len, char delim, struct ccsv_field *fld, int max)
+{
+  struct ccsv_scan sc;
+  size_t s,e,p;
+  int n;
+
+  sc.line=line;
+  sc.len=len;
+  sc.off=(size_t)0-64;
+  sc.mask=0;
+  sc.delim=delim;
+  sc.fn=ccsv_maskfn_get();
+  for(n=0,s=0;n<max;n++)
+  {
+    while(s<len&&line[s]!=delim&&CCSV_ISSPACE(line[s])) ++s;
+    if(s<len&&line[s]=='"')
+    {
+      (void)ccsv_scan_next(&sc); /* the opening quote */
+      fld[n].str=&line[++s];
+      fld[n].type='"';
+      for(e=ccsv_scan_next(&sc);e<len;e=ccsv_scan_next(&sc))
+      {
+        if(line[e]!='"') continue;
+        if(e+1<len&&line[e+1]=='"') (void)ccsv_scan_next(&sc);
+        else break;
+      }
+      fld[n].len=e-s;
+      for(p=e;p<len&&line[p]!=delim;p=ccsv_scan_next(&sc));
+    }
+    else
+    {
+      for(p=(s<len?ccsv_scan_next(&sc):len);p<len&&line[p]!=delim;p=ccsv_scan_next(&sc));
+      for(e=p;e>s&&CCSV_ISSPACE(line[e-1]);--e);
+      fld[n].str=&line[s];
+      fld[n].len=e-s;
+      fld[n].type=delim;
+    }
+    if(p>=len) return(n+1);
+    s=p+1;
+  }
+  return(n);
+}
+
 #endif
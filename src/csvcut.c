@@ -35,13 +35,55 @@
 #include <err.h>
 #include <ctype.h>
 #include <limits.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <regex.h>
 
 #include "config.h"
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "ccsv.h" /* https://github.com/gega/ccsv */
+#include "csvcut_plugin.h"
+#include "csvcut.h"
 
-#define BUFCHUNK (512)
+#define INBUFSIZ (64*1024)
+#define ZBUFSIZ (1024*1024)
+#define ZSLOTS (4)
+#define ZINSIZ (256*1024)
+#define OUTBUFSIZ (64*1024)
+#define SPOOLSIZ (1024*1024)
+#define CHUNKMIN (16*1024)
+#define CHUNKMAX (4*1024*1024)
 #define FLDBUFSIZ (256)
+#define IDXSTEP (1024)
+#define IDXMAGIC "CSVCUTI2"
+#define IDXSUFFIX ".idx"
+#define COLMAGIC "CSVCUTC2"
+#define COLSUFFIX ".cols"
+#define CHUNKROWS (64*1024)
+#define ARROWBATCH (64*1024)
+#define HISTBUCKETS (32)
+#define GROUPMEM (256*1024*1024)
+#define GROUPBLK (1024*1024)
+#define GROUPPARTS (64)
 #define TAG "csvcut"
 #ifndef VERSION_NUMBER
 #error Missing VERSION_NUMBER macro
@@ -57,6 +99,8 @@ enum outtype
   OT_CSV,
   OT_JSON,
   OT_XML,
+  OT_ARROW,
+  OT_NDJSON,
   OTNUM
 };
 
@@ -72,6 +116,8 @@ static struct otypes otc[]=
   { "csv",  OT_CSV, 	1 },
   { "json", OT_JSON, 	0 },
   { "xml",  OT_XML, 	0 },
+  { "arrow", OT_ARROW,	0 },
+  { "ndjson", OT_NDJSON,	0 },
   {NULL}
 };
 
@@ -82,11 +128,160 @@ static int sflag=0; /* skip processing the first row */
 static int qflag=0; /* do not quote fields */
 static enum outtype otype=OT_CSV;
 static char Dchar[]=","; /* default output delimiter is ',' */
-static char **cb=NULL; /* callout command names indexed for fields */
+
+enum cotype
+{
+  CO_SHELL,   /* popen() for each field */
+  CO_COPROC,  /* one long lived process fed with framed requests */
+  CO_BUILTIN, /* chain of built-in transforms, no process at all */
+  CO_PLUGIN,  /* function of a shared object */
+};
+
+enum xfop
+{
+  XF_UPPER,
+  XF_LOWER,
+  XF_TRIM,
+  XF_SUBSTR,
+  XF_PREFIX,
+  XF_SUFFIX,
+  XF_REPLACE,
+  XF_JOIN,
+};
+
+/* one step of a built-in transform chain
+ */
+struct xform
+{
+  enum xfop op;
+  long a,b;              /* substr start and length, b<0 for the rest */
+  char *s1,*s2;          /* prefix, suffix or join string, replace pattern and replacement */
+  size_t l1,l2;
+};
+
+struct callout
+{
+  enum cotype type;
+  char *cmd;
+  int id;                /* index among all callouts */
+  struct xform *xf;      /* compiled CO_BUILTIN chain */
+  int nxf;
+  void *dl;              /* CO_PLUGIN shared object */
+  csvcut_plugin_fn fn;
+  csvcut_plugin_finish_fn finish;
+  void *state;
+  int fmin,fmax;         /* fields of the command */
+  unsigned long calls;   /* --stats, updated atomically */
+  unsigned long hits;    /* answered from the -m cache */
+  uint64_t ns;
+  unsigned long hist[HISTBUCKETS]; /* calls by latency, below 2^i microseconds */
+  struct callout *next;
+};
+
+static struct callout **cb=NULL; /* callouts indexed for fields */
 static int cbsize=0; /* number of callout commands -- should be >= # fields or 0 */
+static struct callout *callouts=NULL; /* all callouts */
+static int ncallouts=0;
 static int cb_pass_fld_max=0;
 static char *cb_pass_fld=NULL;
 static int *reorder_fields=NULL;
+static int jobs=1; /* threads cutting a mapped file */
+static int fjobs=1; /* file arguments cut at the same time */
+static int pjobs=0; /* callout commands running in parallel */
+static size_t outbufsiz=OUTBUFSIZ;
+static int uflag=0; /* flush the output after each row */
+static int xflag=0; /* write sidecar indexes instead of cutting */
+static int Cflag=0; /* write columnar caches instead of cutting */
+static int countflag=0; /* only count the records */
+
+enum aggop
+{
+  AG_COUNT,
+  AG_SUM,
+  AG_MIN,
+  AG_MAX,
+  AG_AVG,
+};
+
+/* an aggregate of -a and its input index
+ */
+struct aggspec
+{
+  enum aggop op;
+  int col;
+};
+
+static int gflag=0; /* -g or -a: print one row of aggregates for each group of rows */
+static int *grpcols=NULL; /* input indexes of the key */
+static int ngrpcols=0;
+static struct aggspec *aggs=NULL;
+static int naggs=0;
+static size_t groupmem=GROUPMEM; /* memory of the groups before they are spilled */
+
+/* -f, -r and -c options naming columns, they are parsed when the first header row is read
+ */
+struct namedopt
+{
+  int opt;
+  char *arg;
+};
+
+/* a name found in the first header row, every file has to have it in the same column
+ */
+struct colname
+{
+  char *name;
+  int col;
+};
+
+static struct namedopt *namedopts=NULL;
+static int nnamedopts=0;
+static struct colname *colnames=NULL;
+static int ncolnames=0;
+static int namesdone=0;
+static pthread_mutex_t namesmtx=PTHREAD_MUTEX_INITIALIZER;
+static size_t idxstep=IDXSTEP;
+static long rowsfrom=0,rowsto=0; /* data rows selected by --rows, 0 is open */
+static long batchrows=ARROWBATCH; /* rows of an arrow record batch */
+
+enum wop
+{
+  W_EQ,       /* == */
+  W_NE,       /* != */
+  W_PREFIX,   /* ^= */
+  W_MATCH,    /* ~ */
+  W_NOMATCH,  /* !~ */
+  W_LT,       /* numeric <, <=, >, >= */
+  W_LE,
+  W_GT,
+  W_GE,
+};
+
+/* predicate of a -w filter on an input field
+ */
+struct wpred
+{
+  int fld;
+  enum wop op;
+  char *str;
+  size_t len;
+  double num;
+  regex_t re;
+};
+
+/* -w filter: alternatives separated by '|' of predicates joined by '&'
+ */
+struct wexpr
+{
+  struct wpred *p;
+  int np;
+  int *term;        /* number of predicates in each alternative */
+  int nterm;
+};
+
+static struct wexpr *filters=NULL; /* a row is cut if all of them match */
+static int nfilters=0;
+static int wfldmax=0; /* highest field used by a filter */
 
 
 static void version(void)
@@ -178,411 +373,4210 @@ static void get_list(char *list)
     memset(positions + 1, '1', autostart);
 }
 
-static int countquotes(char const * str, int *len, char, int *)
+/* --stats: counters and the time spent in each stage of the row pipeline
+   every thread sums its own stage times and merges them when it is done,
+   so with -j and -J the times are the sum over the threads
+ */
+enum stage
 {
-  int ret;
-  for(ret=0,*len=0;*str!='\0';(*len)++,str++) if(*str=='"') ret++;
-  return(ret);
+  ST_READ,      /* reading and reassembling records */
+  ST_TOKENIZE,  /* splitting the fields */
+  ST_PROJECT,   /* filters and the selected values */
+  ST_CALLOUT,
+  ST_FORMAT,    /* formatting and writing the output */
+  NSTAGES
+};
+
+static char const *stagenames[NSTAGES]={"read","tokenize","project","callout","format"};
+
+struct stats
+{
+  uint64_t ns[NSTAGES];
+  unsigned long records;
+  unsigned long rows;
+};
+
+static int statsflag=0;
+static struct stats stats;
+static unsigned long statsfiles,statsreallocs;
+static uint64_t statsbytes;
+static pthread_mutex_t statsmtx=PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return((uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec);
 }
 
-static int countquotes_fld(char const * str, int *len, char dchar, int *fields)
+/* a buffer of the row pipeline was grown, counted even without --stats as it is rare
+ */
+static inline void stats_realloc(void)
 {
-  int ret;
-  for(ret=0,*len=0;*str!='\0';(*len)++,str++) 
-  {
-    if(*str==dchar&&(ret%2)==0) (*fields)++;
-    if(*str=='"') ret++;
-  }
-  return(ret);
+  __atomic_add_fetch(&statsreallocs,1,__ATOMIC_RELAXED);
 }
 
-static char *escape(char *str)
+static void stats_merge(struct stats *st)
 {
-  static const char esc[]={'\n','\t','\r','"','\0'};
-  static const char rpl[]={ 'n', 't', 'r','"','\0'};
-  static char *buf=NULL;
-  static int buflen=0;
-  int len;
-  char *b,*e;
-  
-  if(NULL==str)
+  int i;
+
+  pthread_mutex_lock(&statsmtx);
+  for(i=0;i<NSTAGES;i++) stats.ns[i]+=st->ns[i];
+  stats.records+=st->records;
+  stats.rows+=st->rows;
+  pthread_mutex_unlock(&statsmtx);
+}
+
+static void stats_callout(struct callout *c, uint64_t t0)
+{
+  uint64_t ns=now_ns()-t0,us;
+  int i;
+
+  for(i=0,us=ns/1000;i<HISTBUCKETS-1&&us>=(1ULL<<i);i++);
+  __atomic_add_fetch(&c->calls,1,__ATOMIC_RELAXED);
+  __atomic_add_fetch(&c->ns,ns,__ATOMIC_RELAXED);
+  __atomic_add_fetch(&c->hist[i],1,__ATOMIC_RELAXED);
+}
+
+static void stats_string(FILE *fp, char const *str)
+{
+  fputc('"',fp);
+  for(;*str;str++)
   {
-    if(NULL!=buf) free(buf);
-    buf=NULL;
-    buflen=0;
-    return(NULL);
+    if('"'==*str||'\\'==*str) fprintf(fp,"\\%c",*str);
+    else if((unsigned char)*str<0x20) fprintf(fp,"\\u%04x",*str);
+    else fputc(*str,fp);
   }
-  len=strlen(str);
-  if(buflen<len*2)
+  fputc('"',fp);
+}
+
+/* the report of --stats as one json object on stderr
+ */
+static void stats_print(double secs)
+{
+  static char const *types[]={"shell","coproc","builtin","plugin"};
+  struct callout *c,**cl;
+  int i,k,n;
+
+  fprintf(stderr,"{\"files\":%lu,\"bytes\":%llu,\"records\":%lu,\"rows\":%lu,\"seconds\":%.6f,\"stages\":{",
+          statsfiles,(unsigned long long)statsbytes,stats.records,stats.rows,secs);
+  for(i=0;i<NSTAGES;i++) fprintf(stderr,"%s\"%s\":%.6f",(i>0?",":""),stagenames[i],stats.ns[i]/1e9);
+  fprintf(stderr,"},\"reallocs\":%lu,\"callouts\":[",statsreallocs);
+  /* in the order of the options */
+  if(NULL==(cl=calloc(ncallouts+1,sizeof(struct callout *)))) err(1, "calloc");
+  for(c=callouts;NULL!=c;c=c->next) cl[c->id]=c;
+  for(n=0;n<ncallouts;n++)
   {
-    buflen=len*2;
-    if(NULL!=buf) free(buf);
-    if(NULL==(buf=malloc(buflen+1))) err(1, "malloc");
-    buf[0]='\0';
+    c=cl[n];
+    fprintf(stderr,"%s{\"command\":",(n>0?",":""));
+    stats_string(stderr,c->cmd);
+    fprintf(stderr,",\"type\":\"%s\",\"fields\":[%d,%d],\"calls\":%lu,\"cached\":%lu,\"seconds\":%.6f,\"latency_us\":[",
+            types[c->type],c->fmin+1,c->fmax,c->calls,c->hits,c->ns/1e9);
+    for(k=HISTBUCKETS;k>1&&0==c->hist[k-1];k--);
+    for(i=0;i<k;i++) fprintf(stderr,"%s%lu",(i>0?",":""),c->hist[i]);
+    fprintf(stderr,"]}");
   }
-  for(b=buf+1;*str;str++)
+  fprintf(stderr,"]}\n");
+  free(cl);
+}
+
+/* compressed input is decompressed on a thread into a ring of buffers which the
+   record reader copies from, so decompression and cutting overlap
+ */
+enum zfmt
+{
+  ZF_GZIP,
+  ZF_ZSTD,
+};
+
+struct zslot
+{
+  char *buf;
+  size_t len;     /* decompressed bytes */
+  size_t pos;     /* bytes taken by the reader */
+};
+
+struct zring
+{
+  int fd;
+  enum zfmt fmt;
+  char *in;       /* compressed input, starts with the bytes read to find the format */
+  size_t inlen,inpos;
+  int ineof;
+  struct zslot slot[ZSLOTS];
+  int head;       /* next slot to fill */
+  int tail;       /* next slot to read */
+  int full;       /* filled slots */
+  int eof;        /* no more slots will be filled */
+  int stop;       /* the reader is closed */
+  char const *errmsg;
+  pthread_mutex_t mtx;
+  pthread_cond_t cond;
+  pthread_t th;
+};
+
+/* returns the format of the first bytes of an input or -1 if it is not compressed
+ */
+static int zfmt_detect(char const *p, size_t len)
+{
+  if(len>=2&&0x1f==(unsigned char)p[0]&&0x8b==(unsigned char)p[1]) return(ZF_GZIP);
+  if(len>=4&&0==memcmp(p,"\x28\xb5\x2f\xfd",4)) return(ZF_ZSTD);
+  return(-1);
+}
+
+/* more compressed input, returns 0 at the end of the input
+ */
+static int zring_input(struct zring *z)
+{
+  ssize_t n;
+
+  if(z->inpos<z->inlen) return(1);
+  if(z->ineof) return(0);
+  while((n=read(z->fd,z->in,ZINSIZ))<0&&EINTR==errno);
+  if(n<0) z->errmsg="read error";
+  if(n<=0) z->ineof=1;
+  z->inlen=(n>0?n:0);
+  z->inpos=0;
+  return(n>0);
+}
+
+static void *zring_worker(void *arg)
+{
+  struct zring *z=arg;
+  struct zslot *s;
+  int inframe=0,done=0;
+#ifdef HAVE_ZLIB
+  z_stream zs;
+  int rc;
+#endif
+#ifdef HAVE_ZSTD
+  ZSTD_DStream *ds=NULL;
+  ZSTD_inBuffer ib;
+  ZSTD_outBuffer ob;
+  size_t zr;
+#endif
+
+#ifdef HAVE_ZLIB
+  memset(&zs,0,sizeof(z_stream));
+  if(ZF_GZIP==z->fmt&&Z_OK!=inflateInit2(&zs,15+32)) z->errmsg="inflateInit failed";
+#endif
+#ifdef HAVE_ZSTD
+  if(ZF_ZSTD==z->fmt&&(NULL==(ds=ZSTD_createDStream())||ZSTD_isError(ZSTD_initDStream(ds)))) z->errmsg="ZSTD_initDStream failed";
+#endif
+  while(!done&&NULL==z->errmsg)
   {
-    e=strchr(esc,*str);
-    if(e==NULL)
+    pthread_mutex_lock(&z->mtx);
+    while(ZSLOTS==z->full&&!z->stop) pthread_cond_wait(&z->cond,&z->mtx);
+    s=&z->slot[z->head];
+    done=z->stop;
+    pthread_mutex_unlock(&z->mtx);
+    for(s->len=s->pos=0;!done&&s->len<ZBUFSIZ&&NULL==z->errmsg;)
     {
-      *b++=*str;
-    }
-    else
-    {
-      if(*(b-1)!='"')
+      if(!zring_input(z))
+      {
+        if(inframe&&NULL==z->errmsg) z->errmsg="truncated compressed input";
+        done=1;
+        break;
+      }
+#ifdef HAVE_ZLIB
+      if(ZF_GZIP==z->fmt)
+      {
+        zs.next_in=(unsigned char *)z->in+z->inpos;
+        zs.avail_in=z->inlen-z->inpos;
+        zs.next_out=(unsigned char *)s->buf+s->len;
+        zs.avail_out=ZBUFSIZ-s->len;
+        rc=inflate(&zs,Z_NO_FLUSH);
+        z->inpos=z->inlen-zs.avail_in;
+        s->len=ZBUFSIZ-zs.avail_out;
+        inframe=1;
+        /* concatenated gzip members */
+        if(Z_STREAM_END==rc)
+        {
+          inflateReset(&zs);
+          inframe=0;
+        }
+        else if(Z_OK!=rc&&Z_BUF_ERROR!=rc) z->errmsg=(NULL!=zs.msg?zs.msg:"inflate failed");
+      }
+#endif
+#ifdef HAVE_ZSTD
+      if(ZF_ZSTD==z->fmt)
       {
-        *b++='\\';
-        *b++=rpl[e-esc];
+        ib.src=z->in;
+        ib.size=z->inlen;
+        ib.pos=z->inpos;
+        ob.dst=s->buf;
+        ob.size=ZBUFSIZ;
+        ob.pos=s->len;
+        zr=ZSTD_decompressStream(ds,&ob,&ib);
+        z->inpos=ib.pos;
+        s->len=ob.pos;
+        if(ZSTD_isError(zr)) z->errmsg=ZSTD_getErrorName(zr);
+        inframe=(0!=zr);
       }
+#endif
     }
+    pthread_mutex_lock(&z->mtx);
+    if(s->len>0)
+    {
+      z->head=(z->head+1)%ZSLOTS;
+      z->full++;
+    }
+    if(done||NULL!=z->errmsg) z->eof=1;
+    pthread_cond_broadcast(&z->cond);
+    pthread_mutex_unlock(&z->mtx);
   }
-  *b='\0';
+#ifdef HAVE_ZLIB
+  if(ZF_GZIP==z->fmt) inflateEnd(&zs);
+#endif
+#ifdef HAVE_ZSTD
+  if(NULL!=ds) ZSTD_freeDStream(ds);
+#endif
+  return(NULL);
+}
+
+/* start decompressing fd, the first len bytes of the input were already read into p
+ */
+static struct zring *zring_start(int fd, enum zfmt fmt, char const *p, size_t len)
+{
+  struct zring *z;
+  int i;
 
-  return(buf+1);
+#ifndef HAVE_ZLIB
+  if(ZF_GZIP==fmt) errx(1, "gzip input is not supported, csvcut was built without zlib");
+#endif
+#ifndef HAVE_ZSTD
+  if(ZF_ZSTD==fmt) errx(1, "zstd input is not supported, csvcut was built without libzstd");
+#endif
+  if(NULL==(z=calloc(1,sizeof(struct zring)))) err(1, "calloc");
+  z->fd=fd;
+  z->fmt=fmt;
+  if(NULL==(z->in=malloc(len>ZINSIZ?len:ZINSIZ))) err(1, "malloc");
+  if(len>0) memcpy(z->in,p,len);
+  z->inlen=len;
+  for(i=0;i<ZSLOTS;i++) if(NULL==(z->slot[i].buf=malloc(ZBUFSIZ))) err(1, "malloc");
+  pthread_mutex_init(&z->mtx,NULL);
+  pthread_cond_init(&z->cond,NULL);
+  if(0!=(errno=pthread_create(&z->th,NULL,zring_worker,z))) err(1, "pthread_create");
+  return(z);
 }
 
-static void xmltagsanitize(char *field)
+/* copy decompressed bytes, returns 0 at the end of the input
+ */
+static size_t zring_read(struct zring *z, char *dst, size_t n)
 {
-  if(!isalpha(*field)) *field='_';
-  for(;*field;field++)
+  struct zslot *s;
+
+  int full;
+
+  pthread_mutex_lock(&z->mtx);
+  while(0==z->full&&!z->eof) pthread_cond_wait(&z->cond,&z->mtx);
+  full=z->full;
+  s=&z->slot[z->tail];
+  pthread_mutex_unlock(&z->mtx);
+  if(0==full&&NULL!=z->errmsg) errx(1, "decompression: %s",z->errmsg);
+  if(0==full) return(0);
+  if(n>s->len-s->pos) n=s->len-s->pos;
+  memcpy(dst,s->buf+s->pos,n);
+  s->pos+=n;
+  if(s->pos==s->len)
   {
-    if(!isalnum(*field)) *field='_';
+    pthread_mutex_lock(&z->mtx);
+    z->tail=(z->tail+1)%ZSLOTS;
+    z->full--;
+    pthread_cond_broadcast(&z->cond);
+    pthread_mutex_unlock(&z->mtx);
   }
+  return(n);
 }
 
-static void print_field_csv(char * const field, int col, int prcol, char const * fname)
+static void zring_free(struct zring *z)
 {
-  printf("%s%s%s%s",(prcol==0?"":Dchar),(qflag?"":"\""),(NULL==field?"":field),(qflag?"":"\""));
+  int i;
+
+  pthread_mutex_lock(&z->mtx);
+  z->stop=1;
+  pthread_cond_broadcast(&z->cond);
+  pthread_mutex_unlock(&z->mtx);
+  pthread_join(z->th,NULL);
+  for(i=0;i<ZSLOTS;i++) free(z->slot[i].buf);
+  free(z->in);
+  pthread_cond_destroy(&z->cond);
+  pthread_mutex_destroy(&z->mtx);
+  free(z);
 }
 
-static void print_field_json(char * const field, int col, int prcol, char const * fname)
+/* input of one csv file
+   regular files are mapped read only and the records are parsed in place,
+   anything else is read into a buffer growing geometrically to the longest record
+ */
+struct csvin
 {
-  printf("%s\"%s\":\"%s\"",(prcol==0?"{":","),fname,(NULL==field?"":escape(field)));
-}
+  int fd;
+  char *map;      /* mapped file or NULL when streaming */
+  size_t mapsiz;
+  off_t mapoff;   /* file offset of the mapping */
+  char *buf;      /* stream buffer or copy of an unterminated last record of a mapping */
+  size_t bufsiz;
+  char *pos;      /* first unconsumed byte */
+  char *end;      /* end of valid data */
+  size_t scan;    /* bytes from pos already searched for the end of the record */
+  int quotes;     /* parity of the quotes found in the searched bytes */
+  int eof;
+  struct zring *z; /* decompressor of a compressed stream or NULL */
+  uint64_t nread; /* bytes read from the stream, decompressed */
+};
+
+static void csvin_fill(struct csvin *in);
 
-static void print_field_xml(char * const field, int col, int prcol, char const * fname)
+static void csvin_open(struct csvin *in, FILE *fp)
 {
-  char str[32];
-  if(prcol==0) printf("<row>");
-  if(fname==NULL||strlen(fname)==0)
+  struct stat st;
+  off_t off,aoff;
+  long pgsiz;
+  int fmt=-1;
+
+  memset(in,0,sizeof(struct csvin));
+  in->fd=fileno(fp);
+  if(0==fstat(in->fd,&st)&&S_ISREG(st.st_mode)&&(off=lseek(in->fd,0,SEEK_CUR))>=0&&st.st_size>off)
   {
-    snprintf(str,sizeof(str),"column_%d",prcol);
-    fname=str;
+    pgsiz=sysconf(_SC_PAGESIZE);
+    aoff=off-(off%(pgsiz>0?pgsiz:4096));
+    in->mapsiz=st.st_size-aoff;
+    in->map=mmap(NULL,in->mapsiz,PROT_READ,MAP_PRIVATE,in->fd,aoff);
+    if(MAP_FAILED!=in->map)
+    {
+      (void)madvise(in->map,in->mapsiz,MADV_SEQUENTIAL);
+      in->pos=in->map+(off-aoff);
+      in->mapoff=aoff;
+      in->end=in->map+in->mapsiz;
+      in->eof=1;
+      if((fmt=zfmt_detect(in->pos,in->end-in->pos))<0) return;
+      /* compressed files are streamed through the decompressor from the same offset */
+      munmap(in->map,in->mapsiz);
+      memset(in,0,sizeof(struct csvin));
+      in->fd=fileno(fp);
+    }
+    in->map=NULL;
+  }
+  in->bufsiz=INBUFSIZ;
+  if(NULL==(in->buf=malloc(in->bufsiz+1))) err(1, "malloc");
+  in->pos=in->end=in->buf;
+  if(fmt<0)
+  {
+    while(!in->eof&&in->end-in->pos<4) csvin_fill(in);
+    fmt=zfmt_detect(in->pos,in->end-in->pos);
+  }
+  if(fmt>=0)
+  {
+    in->z=zring_start(in->fd,fmt,in->buf,in->end-in->buf);
+    in->bufsiz=ZBUFSIZ;
+    if(NULL==(in->buf=realloc(in->buf,in->bufsiz+1))) err(1, "realloc");
+    in->pos=in->end=in->buf;
+    in->eof=0;
+    in->nread=0;
   }
-  printf("<%s>%s</%s>",fname,(NULL==field?"":field),fname);
 }
 
-static char *check_callout(char * const field, int col, int prcol, char * const fname, char **values, int valuescnt)
+/* records of a range of an already mapped file
+ */
+static void csvin_range(struct csvin *in, char *start, char *end)
 {
-  static char buf[FLDBUFSIZ];
-  static char *local_field=NULL;
-  static int local_field_size=0;
-  static char *cmd=buf;
-  static int cmdsiz=sizeof(buf);
-  char *ret=field;
-  int ln,l,cs,i;
-  FILE *p;
-  
-  if(NULL==field)
+  memset(in,0,sizeof(struct csvin));
+  in->fd=-1;
+  in->map=start;
+  in->pos=start;
+  in->end=end;
+  in->eof=1;
+}
+
+static void csvin_close(struct csvin *in)
+{
+  if(NULL!=in->z) zring_free(in->z);
+  if(NULL!=in->map&&0<in->mapsiz) munmap(in->map,in->mapsiz);
+  if(NULL!=in->buf) free(in->buf);
+  memset(in,0,sizeof(struct csvin));
+}
+
+static void csvin_fill(struct csvin *in)
+{
+  size_t off;
+  ssize_t n;
+
+  if(in->pos>in->buf)
   {
-    if(NULL!=local_field) free(local_field);
-    local_field=NULL;
-    local_field_size=0;
-    if(cmd!=buf) free(cmd);
-    cmd=buf;
-    cmdsiz=sizeof(buf);
-    return(ret);
+    memmove(in->buf,in->pos,in->end-in->pos);
+    in->end-=in->pos-in->buf;
+    in->pos=in->buf;
   }
-  if(cb==NULL) return(ret);
-  if(local_field==NULL)
+  if(in->end==in->buf+in->bufsiz)
   {
-    local_field_size=FLDBUFSIZ;
-    if(NULL==(local_field=malloc(local_field_size))) err(1, "malloc");
-    local_field[0]='\0';
+    off=in->end-in->buf;
+    in->bufsiz*=2;
+    stats_realloc();
+    if(NULL==(in->buf=realloc(in->buf,in->bufsiz+1))) err(1, "realloc");
+    in->pos=in->buf;
+    in->end=in->buf+off;
   }
-  if(cbsize>col&&NULL!=cb[col])
+  if(NULL!=in->z) n=zring_read(in->z,in->end,in->buf+in->bufsiz-in->end);
+  else while((n=read(in->fd,in->end,in->buf+in->bufsiz-in->end))<0&&EINTR==errno);
+  if(n<0) err(1, "read");
+  if(0==n) in->eof=1;
+  in->end+=n;
+  in->nread+=n;
+}
+
+/* returns the next record or NULL at the end of the input
+   a newline inside a quoted field does not end the record
+   the byte after the record is readable: it is the newline or a terminating \0
+ */
+static char *csvin_next(struct csvin *in, size_t *len)
+{
+  char *nl,*ret;
+
+  for(;;)
   {
-    cs=1+snprintf(cmd,cmdsiz,"%s %d %d \"%s\" \"%s\"",cb[col],col,prcol,fname,field);
-    for(i=0;i<cb_pass_fld_max;i++)
-    {
-      if(cb_pass_fld[i]!=0&&values[i]!=NULL) cs+=3+strlen(values[i]);
-    }
-    if(cs>cmdsiz)
+    if(NULL!=(nl=(char *)csvcut_recend(in->pos+in->scan,in->end,&in->quotes)))
     {
-      cs*=2;
-      if(cmd!=buf) free(cmd);
-      if(NULL==(cmd=malloc(cs))) err(1, "malloc");
-      cmdsiz=cs;
-      snprintf(cmd,cmdsiz,"%s %d %d \"%s\" \"%s\"",cb[col],col,prcol,fname,field);
-    }
-    for(i=0;i<cb_pass_fld_max;i++)
-    {
-      if(cb_pass_fld[i]!=0&&values[i]!=NULL)
-      {
-        strcat(cmd," \"");
-        strcat(cmd,values[i]);
-        strcat(cmd,"\"");
-      }
+      ret=in->pos;
+      *len=nl-ret;
+      in->pos=nl+1;
+      in->scan=0;
+      return(ret);
     }
-    if((p=popen(cmd,"r")))
+    in->scan=in->end-in->pos;
+    if(in->eof) break;
+    csvin_fill(in);
+  }
+  if(in->pos==in->end) return(NULL);
+  *len=in->end-in->pos;
+  if(NULL!=in->map)
+  {
+    /* no room for the terminator after the end of the mapping */
+    if(NULL==(in->buf=malloc(*len+1))) err(1, "malloc");
+    memcpy(in->buf,in->pos,*len);
+    ret=in->buf;
+  }
+  else ret=in->pos;
+  ret[*len]='\0';
+  in->pos=in->end;
+  in->scan=0;
+  in->quotes=0;
+  return(ret);
+}
+
+/* what a sidecar file of a regular file was built from, a file rewritten in place within
+   the same second or replaced by another one has a different stamp
+ */
+struct filestamp
+{
+  uint64_t size;
+  int64_t mtime;
+  int64_t mtimensec;
+  uint64_t ino;
+  uint64_t dev;
+};
+
+static void file_stamp(struct filestamp *fs, struct stat const *st)
+{
+  memset(fs,0,sizeof(struct filestamp));
+  fs->size=st->st_size;
+  fs->mtime=st->st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+  fs->mtimensec=st->st_mtim.tv_nsec;
+#endif
+  fs->ino=st->st_ino;
+  fs->dev=st->st_dev;
+}
+
+static int file_stamp_eq(struct filestamp const *fs, struct stat const *st)
+{
+  struct filestamp cur;
+
+  file_stamp(&cur,st);
+  return(0==memcmp(fs,&cur,sizeof(struct filestamp)));
+}
+
+/* sidecar index of a regular file, written to <file>.idx by --index
+   struct idxhdr, the header record and the file offsets of every step'th data record
+   the file is stale when its stamp or header is different
+ */
+struct idxhdr
+{
+  char magic[8];
+  struct filestamp stamp;
+  uint64_t rows;     /* data records after the header */
+  uint64_t hdrlen;
+  uint64_t noffs;
+  uint32_t step;
+  uint32_t fldnum;
+};
+
+struct csvidx
+{
+  struct idxhdr h;
+  uint64_t *offs;
+};
+
+static char *index_path(char const *fnam)
+{
+  char *path;
+
+  if(NULL==(path=malloc(strlen(fnam)+sizeof(IDXSUFFIX)))) err(1, "malloc");
+  strcpy(path,fnam);
+  strcat(path,IDXSUFFIX);
+  return(path);
+}
+
+static int index_build(FILE *fp, char const *fnam, char dchar)
+{
+  struct csvin in;
+  struct idxhdr h;
+  struct stat st;
+  uint64_t *offs=NULL;
+  size_t len,nalloc=0;
+  char *hdr,*p,*path;
+  FILE *out;
+  int ret=0;
+
+  csvin_open(&in,fp);
+  if(NULL==in.map||0!=fstat(in.fd,&st))
+  {
+    warnx("%s: only non-empty regular files can be indexed",fnam);
+    csvin_close(&in);
+    return(1);
+  }
+  memset(&h,0,sizeof(struct idxhdr));
+  memcpy(h.magic,IDXMAGIC,sizeof(h.magic));
+  file_stamp(&h.stamp,&st);
+  h.step=idxstep;
+  hdr=csvin_next(&in,&len);
+  h.hdrlen=len;
+  h.fldnum=csvcut_countfields(hdr,len,dchar);
+  for(p=in.pos;NULL!=csvin_next(&in,&len);p=in.pos,h.rows++)
+  {
+    if(0!=h.rows%idxstep) continue;
+    if(h.noffs==nalloc)
     {
-      for(ln=0,l=FLDBUFSIZ;l==FLDBUFSIZ;ln+=l)
-      {
-        l=fread(&local_field[ln],1,FLDBUFSIZ,p);
-        if(l==FLDBUFSIZ) if(NULL==(local_field=realloc(local_field,ln+FLDBUFSIZ))) err(1, "realloc");
-      }
-      if(0!=(pclose(p)))
-      {
-        fprintf(stderr,"Failed to call '%s'\n",cb[col]);
-        free(cb[col]);
-        cb[col]=NULL;
-      }
-      else if(ln>0)
-      {
-        local_field[ln]='\0';
-        ret=local_field;
-      }
+      nalloc=(0==nalloc?64:nalloc*2);
+      if(NULL==(offs=realloc(offs,nalloc*sizeof(uint64_t)))) err(1, "realloc");
     }
-    else
+    offs[h.noffs++]=in.mapoff+(p-in.map);
+  }
+  path=index_path(fnam);
+  if(NULL==(out=fopen(path,"wb")))
+  {
+    warn("%s",path);
+    ret=1;
+  }
+  else
+  {
+    fwrite(&h,sizeof(struct idxhdr),1,out);
+    fwrite(hdr,1,h.hdrlen,out);
+    if(h.noffs>0) fwrite(offs,sizeof(uint64_t),h.noffs,out);
+    if(ferror(out)|fclose(out))
     {
-      fprintf(stderr,"Cannot open '%s'\n",cb[col]);
-      free(cb[col]);
-      cb[col]=NULL;
+      warn("%s",path);
+      unlink(path);
+      ret=1;
     }
   }
-  
+  free(path);
+  if(NULL!=offs) free(offs);
+  csvin_close(&in);
   return(ret);
 }
 
-static int csv_cut(FILE *fp, const char *fnam, char dchar)
+/* load the index of a mapped file positioned after its header record
+   returns 0 if there is no usable index
+ */
+static int index_load(struct csvidx *ix, struct csvin *in, char const *fnam, char const *hdr, size_t hdrlen)
 {
-  struct ccsv c;
-  char *f,typ='\0',lastchar;
-  char *buf;
-  int bufsiz,lnxsiz;
-  char *end;
-  int noq,req=0,len,col,i,lnx,noqc,lineno=0;
-  int (*countq)(char const *,int *,char,int *);
-  int fldnum=1;
-  char **fields=NULL;
-  char **values=NULL;
-  char **procval=NULL;
-  char **out_fields=NULL;
-  int *cmbn_flds=NULL;
-  int cmbn_type;
-  void (*prfld)(char * const, int, int, char const *);
-
-  bufsiz=BUFCHUNK;
-  if(NULL==(buf=malloc(bufsiz))) err(1, "malloc");
-  end=buf;
-  countq=countquotes_fld;
-  prfld=print_field_csv;
-  if(OT_JSON==otype)
+  struct stat st;
+  char *path,*buf=NULL;
+  uint64_t lo,hi;
+  size_t k;
+  FILE *f;
+  int ret=0;
+
+  memset(ix,0,sizeof(struct csvidx));
+  if(NULL==in->map||0!=fstat(in->fd,&st)) return(0);
+  path=index_path(fnam);
+  if(NULL==(f=fopen(path,"rb")))
   {
-    prfld=print_field_json;
-    printf("[");
+    free(path);
+    return(0);
   }
-  else if(OT_XML==otype)
+  if(1!=fread(&ix->h,sizeof(struct idxhdr),1,f)||0!=memcmp(ix->h.magic,IDXMAGIC,sizeof(ix->h.magic))||0==ix->h.step||ix->h.noffs>ix->h.stamp.size)
   {
-    prfld=print_field_xml;
-    printf("<xml>");
+    warnx("%s: not an index",path);
   }
-  while(NULL!=end)
+  else if(!file_stamp_eq(&ix->h.stamp,&st)||ix->h.hdrlen!=hdrlen
+    ||NULL==(buf=malloc(hdrlen+1))||hdrlen!=fread(buf,1,hdrlen,f)||0!=memcmp(buf,hdr,hdrlen))
   {
-    for(buf[0]='\0',req=1,lnx=0,lnxsiz=bufsiz,noq=0; NULL!=end&&noq!=req; )
-    {
-      req=1-req;
-      for(noqc=0,lastchar='\0';lastchar!='\n';)
-      {
-        end=fgets(&buf[lnx],lnxsiz,fp);
-        if(NULL==end) break;
-        noqc+=countq(&buf[lnx],&len,dchar,&fldnum);
-        lnx+=len;
-        lnxsiz-=len;
-        lastchar=buf[lnx-1];
-        if('\n'!=lastchar)
-        {
-          bufsiz+=BUFCHUNK;
-          lnxsiz+=BUFCHUNK;
-          buf=realloc(buf,bufsiz);
-          if(NULL==buf) err(1, "realloc");
-        }
-      }
-      noq=noqc%2;
-    }
-    lineno++;
-    countq=countquotes;
-    if(lineno==1)
+    warnx("%s: index is stale, ignored",path);
+  }
+  else if(NULL==(ix->offs=malloc(ix->h.noffs*sizeof(uint64_t)+1))||ix->h.noffs!=fread(ix->offs,sizeof(uint64_t),ix->h.noffs,f))
+  {
+    warnx("%s: truncated index",path);
+  }
+  else
+  {
+    /* the offsets have to be increasing records of the mapping after the header */
+    lo=in->mapoff+(in->pos-in->map);
+    hi=in->mapoff+(in->end-in->map);
+    for(k=0;k<ix->h.noffs&&ix->offs[k]>=lo&&ix->offs[k]<hi;lo=ix->offs[k++]+1);
+    if(k<ix->h.noffs) warnx("%s: bad offsets in index",path);
+    else ret=1;
+  }
+  if(!ret&&NULL!=ix->offs)
+  {
+    free(ix->offs);
+    ix->offs=NULL;
+  }
+  if(NULL!=buf) free(buf);
+  fclose(f);
+  free(path);
+  return(ret);
+}
+
+/* returns the start of data row target of a mapped input, p is the start of row
+   the index gives the last sampled row before target, the rest is skipped record by record
+ */
+static char *index_row(struct csvin *in, struct csvidx *ix, char *p, long row, long target)
+{
+  struct csvin rg;
+  size_t len,s;
+
+  if(NULL!=ix&&target>row)
+  {
+    s=(target-1)/ix->h.step;
+    if(s<ix->h.noffs&&(long)(s*ix->h.step+1)>row)
     {
-      fields=calloc(fldnum,sizeof(char *));
-      values=calloc(fldnum,sizeof(char *));
-      procval=calloc(fldnum,sizeof(char *));
-      cmbn_flds=calloc(fldnum*2,sizeof(int));
+      p=in->map+(ix->offs[s]-in->mapoff);
+      row=s*ix->h.step+1;
     }
+  }
+  csvin_range(&rg,p,in->end);
+  for(;row<target&&NULL!=csvin_next(&rg,&len);row++);
+  p=rg.pos;
+  csvin_close(&rg);
+  return(p);
+}
 
-    if('\0'!=buf[0])
-    {
-      if(lineno>2)
-      {
-        if(OT_JSON==otype) printf(",");
-        else if(OT_XML==otype) printf("</row>");
+/* columnar cache of a regular file, written to <file>.cols by --cache
+   struct colhdr, the header record, the number of fields of each row, struct colent of each
+   column and the columns: rows+1 offsets followed by the values, each one terminated by a \0
+   only the pages of the columns cut are read from the mapping
+ */
+struct colhdr
+{
+  char magic[8];
+  struct filestamp stamp;
+  uint64_t rows;
+  uint64_t hdrlen;
+  uint32_t fldnum;
+  uint32_t dchar;
+};
+
+struct colent
+{
+  uint64_t off;      /* offset of the column in the cache */
+  uint64_t len;      /* bytes of the values */
+};
+
+struct colcache
+{
+  char *map;
+  size_t mapsiz;
+  struct colhdr *h;
+  uint32_t *nf;      /* fields of each row */
+  struct colent *dir;
+  char *path;
+};
+
+#define ALIGN8(n) (((n)+7)&~(uint64_t)7)
+
+static int cache_build(FILE *fp, char const *fnam, char dchar)
+{
+  struct csvin in,rg;
+  struct colhdr h;
+  struct colent *dir;
+  struct ccsv_field *flds;
+  struct stat st;
+  uint64_t *cur,*offs;
+  uint64_t siz,nfoff,diroff,row,flen;
+  uint32_t *nf;
+  char *hdr,*buf,*map,*path,*tmp;
+  size_t len,i;
+  int fd,n,ret=0;
+
+  csvin_open(&in,fp);
+  if(NULL==in.map||0!=fstat(in.fd,&st))
+  {
+    warnx("%s: only non-empty regular files can be cached",fnam);
+    csvin_close(&in);
+    return(1);
+  }
+  memset(&h,0,sizeof(struct colhdr));
+  memcpy(h.magic,COLMAGIC,sizeof(h.magic));
+  file_stamp(&h.stamp,&st);
+  h.dchar=(unsigned char)dchar;
+  hdr=csvin_next(&in,&len);
+  h.hdrlen=len;
+  h.fldnum=csvcut_countfields(hdr,len,dchar);
+  flds=calloc(h.fldnum,sizeof(struct ccsv_field));
+  dir=calloc(h.fldnum,sizeof(struct colent));
+  cur=calloc(h.fldnum,sizeof(uint64_t));
+  if(NULL==flds||NULL==dir||NULL==cur) err(1, "calloc");
+
+  /* the first pass sizes the columns */
+  csvin_range(&rg,in.pos,in.end);
+  for(;NULL!=(buf=csvin_next(&rg,&len));h.rows++)
+  {
+    n=ccsv_split(buf,len,dchar,flds,h.fldnum);
+    for(i=0;i<h.fldnum;i++) dir[i].len+=((int)i<n?flds[i].len:0)+1;
+  }
+  csvin_close(&rg);
+  nfoff=ALIGN8(sizeof(struct colhdr)+h.hdrlen+1);
+  diroff=nfoff+ALIGN8(h.rows*sizeof(uint32_t));
+  siz=diroff+h.fldnum*sizeof(struct colent);
+  for(i=0;i<h.fldnum;i++)
+  {
+    dir[i].off=siz;
+    siz+=(h.rows+1)*sizeof(uint64_t)+ALIGN8(dir[i].len);
+  }
+
+  /* written to a temporary file renamed to the cache, a reader never maps a half written one */
+  path=malloc(strlen(fnam)+sizeof(COLSUFFIX));
+  tmp=malloc(strlen(fnam)+sizeof(COLSUFFIX)+24);
+  if(NULL==path||NULL==tmp) err(1, "malloc");
+  strcpy(path,fnam);
+  strcat(path,COLSUFFIX);
+  sprintf(tmp,"%s.%ld",path,(long)getpid());
+  map=MAP_FAILED;
+  if((fd=open(tmp,O_RDWR|O_CREAT|O_TRUNC,0666))<0||0!=ftruncate(fd,siz)
+    ||MAP_FAILED==(map=mmap(NULL,siz,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0)))
+  {
+    warn("%s",tmp);
+    ret=1;
+  }
+  else
+  {
+    /* the second pass scatters the values into the columns
+       a file changed since the first pass may not fit the sizes, the cache is not written then
+     */
+    memcpy(map,&h,sizeof(struct colhdr));
+    memcpy(map+sizeof(struct colhdr),hdr,h.hdrlen);
+    map[sizeof(struct colhdr)+h.hdrlen]='\n';
+    memcpy(map+diroff,dir,h.fldnum*sizeof(struct colent));
+    nf=(uint32_t *)(map+nfoff);
+    csvin_range(&rg,in.pos,in.end);
+    for(row=0;0==ret&&NULL!=(buf=csvin_next(&rg,&len));row++)
+    {
+      if(row==h.rows)
+      {
+        ret=1;
+        break;
+      }
+      n=nf[row]=ccsv_split(buf,len,dchar,flds,h.fldnum);
+      for(i=0;i<h.fldnum;i++)
+      {
+        flen=((int)i<n?flds[i].len:0);
+        if(cur[i]+flen+1>dir[i].len)
+        {
+          ret=1;
+          break;
+        }
+        offs=(uint64_t *)(map+dir[i].off);
+        offs[row]=cur[i];
+        if((int)i<n) memcpy((char *)&offs[h.rows+1]+cur[i],flds[i].str,flen);
+        cur[i]+=flen+1;
+      }
+    }
+    csvin_close(&rg);
+    if(row!=h.rows) ret=1;
+    if(ret) warnx("%s: file changed while it was cached",fnam);
+    else for(i=0;i<h.fldnum;i++) ((uint64_t *)(map+dir[i].off))[h.rows]=cur[i];
+    if(0!=munmap(map,siz))
+    {
+      warn("%s",tmp);
+      ret=1;
+    }
+  }
+  if(fd>=0&&0!=close(fd)) ret=1;
+  if(!ret&&0!=rename(tmp,path))
+  {
+    warn("%s",path);
+    ret=1;
+  }
+  if(ret&&fd>=0) unlink(tmp);
+  free(tmp);
+  free(path);
+  free(cur);
+  free(dir);
+  free(flds);
+  csvin_close(&in);
+  return(ret);
+}
+
+/* map the cache of a file positioned after its header record
+   returns 0 if there is no usable cache
+ */
+static int cache_load(struct colcache *cc, struct csvin *in, char const *fnam, char dchar, char const *hdr, size_t hdrlen)
+{
+  struct stat st,cst;
+  struct colhdr *h;
+  char path[PATH_MAX];
+  uint64_t siz;
+  size_t i;
+  int fd;
+
+  memset(cc,0,sizeof(struct colcache));
+  if(NULL==in->map||0!=fstat(in->fd,&st)) return(0);
+  if((int)sizeof(path)<=snprintf(path,sizeof(path),"%s" COLSUFFIX,fnam)||(fd=open(path,O_RDONLY))<0) return(0);
+  if(NULL==(cc->path=strdup(path))) err(1, "strdup");
+  if(0==fstat(fd,&cst)&&cst.st_size>=(off_t)sizeof(struct colhdr))
+  {
+    cc->mapsiz=cst.st_size;
+    if(MAP_FAILED==(cc->map=mmap(NULL,cc->mapsiz,PROT_READ,MAP_SHARED,fd,0))) cc->map=NULL;
+  }
+  close(fd);
+  h=cc->h=(struct colhdr *)cc->map;
+  if(NULL==h||0!=memcmp(h->magic,COLMAGIC,sizeof(h->magic))) warnx("%s: not a column cache",cc->path);
+  else if(!file_stamp_eq(&h->stamp,&st)||h->hdrlen!=hdrlen||h->dchar!=(unsigned char)dchar
+    ||h->hdrlen>cc->mapsiz-sizeof(struct colhdr)||0!=memcmp(cc->map+sizeof(struct colhdr),hdr,hdrlen))
+  {
+    warnx("%s: cache is stale, ignored",cc->path);
+  }
+  else if(h->rows>cc->mapsiz/sizeof(uint64_t)) warnx("%s: bad column cache",cc->path);
+  else
+  {
+    siz=ALIGN8(sizeof(struct colhdr)+h->hdrlen+1);
+    cc->nf=(uint32_t *)(cc->map+siz);
+    siz+=ALIGN8(h->rows*sizeof(uint32_t));
+    cc->dir=(struct colent *)(cc->map+siz);
+    siz+=h->fldnum*sizeof(struct colent);
+    for(i=0;siz<=cc->mapsiz&&i<h->fldnum;i++)
+    {
+      if(cc->dir[i].off<siz||cc->dir[i].off>cc->mapsiz) break;
+      siz=cc->dir[i].off+(h->rows+1)*sizeof(uint64_t)+ALIGN8(cc->dir[i].len);
+    }
+    if(i<h->fldnum||siz>cc->mapsiz) warnx("%s: bad column cache",cc->path);
+    else return(1);
+  }
+  if(NULL!=cc->map) munmap(cc->map,cc->mapsiz);
+  free(cc->path);
+  memset(cc,0,sizeof(struct colcache));
+  return(0);
+}
+
+static void cache_free(struct colcache *cc)
+{
+  if(NULL!=cc->map) munmap(cc->map,cc->mapsiz);
+  if(NULL!=cc->path) free(cc->path);
+  memset(cc,0,sizeof(struct colcache));
+}
+
+/* value of a column of a row, the offsets are checked as only the columns used are validated
+ */
+static void cache_field(struct colcache *cc, int col, uint64_t row, struct ccsv_field *fld)
+{
+  struct colent *d=&cc->dir[col];
+  uint64_t *offs=(uint64_t *)(cc->map+d->off);
+
+  if(offs[row+1]<=offs[row]||offs[row+1]>d->len) errx(1, "%s: corrupt column cache",cc->path);
+  fld->str=(char *)&offs[cc->h->rows+1]+offs[row];
+  fld->len=offs[row+1]-offs[row]-1;
+}
+
+/* output collected in a buffer and written with write() when it is full
+   a buffer without a file descriptor keeps growing, the rows of a chunk are collected this way
+ */
+struct outbuf
+{
+  int fd;
+  char *buf;
+  size_t len;
+  size_t siz;
+};
+
+static struct outbuf stdoutbuf;
+
+static void outbuf_init(struct outbuf *o, int fd, size_t siz)
+{
+  o->fd=fd;
+  o->len=0;
+  o->siz=siz;
+  if(NULL==(o->buf=malloc(o->siz))) err(1, "malloc");
+}
+
+static void outbuf_free(struct outbuf *o)
+{
+  if(NULL!=o->buf) free(o->buf);
+  memset(o,0,sizeof(struct outbuf));
+  o->fd=-1;
+}
+
+static void outbuf_writev(struct outbuf *o, struct iovec *iov, int cnt)
+{
+  ssize_t n;
+
+  while(cnt>0)
+  {
+    if(0>(n=writev(o->fd,iov,cnt)))
+    {
+      if(EINTR==errno) continue;
+      err(1, "write");
+    }
+    for(;cnt>0&&(size_t)n>=iov->iov_len;cnt--,iov++) n-=iov->iov_len;
+    if(cnt>0)
+    {
+      iov->iov_base=(char *)iov->iov_base+n;
+      iov->iov_len-=n;
+    }
+  }
+}
+
+static void outbuf_flush(struct outbuf *o)
+{
+  struct iovec iov;
+
+  if(0>o->fd||0==o->len) return;
+  iov.iov_base=o->buf;
+  iov.iov_len=o->len;
+  outbuf_writev(o,&iov,1);
+  o->len=0;
+}
+
+static void outbuf_write(struct outbuf *o, char const *str, size_t len)
+{
+  struct iovec iov[2];
+
+  if(o->len+len>o->siz)
+  {
+    if(0>o->fd)
+    {
+      o->siz=2*(o->len+len);
+      stats_realloc();
+      if(NULL==(o->buf=realloc(o->buf,o->siz))) err(1, "realloc");
+    }
+    else if(len>=o->siz)
+    {
+      /* too long to copy, write it together with the buffer */
+      iov[0].iov_base=o->buf;
+      iov[0].iov_len=o->len;
+      iov[1].iov_base=(char *)str;
+      iov[1].iov_len=len;
+      outbuf_writev(o,iov,2);
+      o->len=0;
+      return;
+    }
+    else outbuf_flush(o);
+  }
+  memcpy(&o->buf[o->len],str,len);
+  o->len+=len;
+}
+
+static inline void outbuf_puts(struct outbuf *o, char const *str)
+{
+  outbuf_write(o,str,strlen(str));
+}
+
+static inline void outbuf_putc(struct outbuf *o, char c)
+{
+  if(o->len==o->siz) outbuf_write(o,&c,1);
+  else o->buf[o->len++]=c;
+}
+
+/* append the contents of a file, the buffer has to write to a file descriptor
+ */
+static void outbuf_copy(struct outbuf *o, int fd)
+{
+  ssize_t n;
+
+  if(0>=lseek(fd,0,SEEK_END)) return;
+  if(0>lseek(fd,0,SEEK_SET)) err(1, "lseek");
+  outbuf_flush(o);
+  for(;;)
+  {
+    if(0>(n=read(fd,o->buf,o->siz)))
+    {
+      if(EINTR==errno) continue;
+      err(1, "read");
+    }
+    if(0==n) break;
+    o->len=n;
+    outbuf_flush(o);
+  }
+}
+
+static void stdoutbuf_flush(void)
+{
+  outbuf_flush(&stdoutbuf);
+}
+
+/* Arrow IPC stream of string columns for -o arrow
+   the values of each output column are collected until batchrows rows and written as a
+   record batch after the schema message, the metadata flatbuffers are built front to back
+ */
+struct arrowcol
+{
+  int32_t *offs;     /* n+1 offsets into data */
+  char *data;
+  size_t len,siz;
+  uint8_t *valid;    /* validity bitmap, a bit is clear for a missing value */
+  long n;            /* values in the batch */
+  long nnull;
+};
+
+struct arrowbatch
+{
+  struct arrowcol *cols;
+  int ncols;
+  long rows;
+  long cap;          /* rows allocated in each column */
+};
+
+struct fbb
+{
+  unsigned char *buf;
+  size_t len,siz;
+};
+
+/* a table field, the fields of a table are listed by decreasing size
+ */
+struct fbfld
+{
+  int id;
+  int size;
+  uint64_t val;
+  size_t pos;        /* set to the position of the field */
+};
+
+static size_t fb_put(struct fbb *b, void const *p, size_t n)
+{
+  size_t pos=b->len;
+
+  if(b->len+n>b->siz)
+  {
+    b->siz=(b->len+n)*2;
+    if(NULL==(b->buf=realloc(b->buf,b->siz))) err(1, "realloc");
+  }
+  if(NULL!=p) memcpy(b->buf+b->len,p,n);
+  else memset(b->buf+b->len,0,n);
+  b->len+=n;
+  return(pos);
+}
+
+/* flatbuffers are little endian on every host
+ */
+static size_t fb_int(struct fbb *b, uint64_t val, int size)
+{
+  unsigned char le[8];
+  int i;
+
+  for(i=0;i<size;i++,val>>=8) le[i]=val&0xff;
+  return(fb_put(b,le,size));
+}
+
+/* pad until the length is rem modulo align
+ */
+static void fb_pad(struct fbb *b, size_t align, size_t rem)
+{
+  while(b->len%align!=rem) fb_put(b,NULL,1);
+}
+
+/* point the offset at pos to an object written later at to
+ */
+static void fb_patch(struct fbb *b, size_t pos, size_t to)
+{
+  size_t len=b->len;
+
+  b->len=pos;
+  fb_int(b,to-pos,4);
+  b->len=len;
+}
+
+/* vtable and table, the table starts at 4 modulo 8 so its fields after the vtable offset are aligned
+ */
+static size_t fb_table(struct fbb *b, struct fbfld *f, int n)
+{
+  size_t vt,tbl;
+  int i,nid,off;
+
+  for(i=nid=0;i<n;i++) if(f[i].id>=nid) nid=f[i].id+1;
+  fb_pad(b,2,0);
+  vt=fb_int(b,4+2*nid,2);
+  for(i=off=0;i<n;i++) off+=f[i].size;
+  fb_int(b,4+off,2);
+  fb_put(b,NULL,2*nid);
+  for(i=0,off=4;i<n;off+=f[i++].size) b->buf[vt+4+2*f[i].id]=off;
+  fb_pad(b,8,4);
+  tbl=fb_int(b,b->len-vt,4);
+  for(i=0;i<n;i++) f[i].pos=fb_int(b,f[i].val,f[i].size);
+  return(tbl);
+}
+
+static size_t fb_string(struct fbb *b, char const *str)
+{
+  size_t pos;
+
+  fb_pad(b,4,0);
+  pos=fb_int(b,strlen(str),4);
+  fb_put(b,str,strlen(str)+1);
+  return(pos);
+}
+
+/* Message with an empty header table of the given type, returns the header offset to patch
+ */
+static size_t arrow_msghead(struct fbb *b, int type, uint64_t bodylen)
+{
+  struct fbfld msg[]={{3,8,bodylen,0},{2,4,0,0},{0,2,4 /* V5 */,0},{1,1,type,0}};
+
+  b->len=0;
+  fb_put(b,NULL,4);
+  fb_patch(b,0,fb_table(b,msg,4));
+  return(msg[1].pos);
+}
+
+/* continuation marker, metadata length and the metadata padded for the body
+ */
+static void arrow_message(struct outbuf *out, struct fbb *b)
+{
+  unsigned char pre[8]={0xff,0xff,0xff,0xff};
+  size_t len;
+  int i;
+
+  fb_pad(b,8,0);
+  for(i=0,len=b->len;i<4;i++,len>>=8) pre[4+i]=len&0xff;
+  outbuf_write(out,(char *)pre,8);
+  outbuf_write(out,(char *)b->buf,b->len);
+}
+
+static void arrow_schema(struct outbuf *out, char const **names, int n)
+{
+  static const union { uint16_t u; char c; } bo={1};
+  struct fbb b;
+  size_t hdr,vec,pos;
+  int i;
+
+  memset(&b,0,sizeof(struct fbb));
+  hdr=arrow_msghead(&b,1 /* Schema */,0);
+  {
+    struct fbfld schema[]={{1,4,0,0},{0,2,(1==bo.c?0:1) /* endianness of the buffers */,0}};
+    fb_patch(&b,hdr,fb_table(&b,schema,2));
+    fb_pad(&b,4,0);
+    fb_patch(&b,schema[0].pos,fb_int(&b,n,4));
+  }
+  vec=fb_put(&b,NULL,4*n);
+  for(i=0;i<n;i++)
+  {
+    struct fbfld field[]={{0,4,0,0},{3,4,0,0},{5,4,0,0},{1,1,1 /* nullable */,0},{2,1,5 /* Utf8 */,0}};
+    fb_patch(&b,vec+4*i,fb_table(&b,field,5));
+    fb_patch(&b,field[0].pos,fb_string(&b,(NULL==names[i]?"":names[i])));
+    fb_patch(&b,field[1].pos,fb_table(&b,NULL,0));
+    fb_pad(&b,4,0);
+    pos=fb_int(&b,0,4);
+    fb_patch(&b,field[2].pos,pos);
+  }
+  arrow_message(out,&b);
+  free(b.buf);
+}
+
+static void arrow_eos(struct outbuf *out)
+{
+  outbuf_write(out,"\xff\xff\xff\xff\0\0\0\0",8);
+}
+
+static void arrow_init(struct arrowbatch *ab, int ncols)
+{
+  memset(ab,0,sizeof(struct arrowbatch));
+  ab->ncols=ncols;
+  if(NULL==(ab->cols=calloc(ncols+1,sizeof(struct arrowcol)))) err(1, "calloc");
+}
+
+static void arrow_free(struct arrowbatch *ab)
+{
+  int i;
+
+  for(i=0;i<ab->ncols;i++)
+  {
+    if(NULL!=ab->cols[i].offs) free(ab->cols[i].offs);
+    if(NULL!=ab->cols[i].data) free(ab->cols[i].data);
+    if(NULL!=ab->cols[i].valid) free(ab->cols[i].valid);
+  }
+  if(NULL!=ab->cols) free(ab->cols);
+  memset(ab,0,sizeof(struct arrowbatch));
+}
+
+/* append a value of the current row, NULL is a missing value
+   quotes doubled inside a quoted field are stored once
+ */
+static void arrow_value(struct arrowbatch *ab, int col, char const *str, size_t len)
+{
+  struct arrowcol *c=&ab->cols[col];
+  char const *end=str+len;
+  char *d;
+  long i;
+
+  if(c->n>=ab->cap)
+  {
+    ab->cap=(0==ab->cap?1024:ab->cap*2);
+    for(i=0;i<ab->ncols;i++)
+    {
+      ab->cols[i].offs=realloc(ab->cols[i].offs,(ab->cap+1)*sizeof(int32_t));
+      ab->cols[i].valid=realloc(ab->cols[i].valid,(ab->cap+7)/8);
+      if(NULL==ab->cols[i].offs||NULL==ab->cols[i].valid) err(1, "realloc");
+    }
+  }
+  if(0==c->n) c->offs[0]=0;
+  if(0==(c->n%8)) c->valid[c->n/8]=0;
+  if(NULL==str)
+  {
+    c->nnull++;
+    len=0;
+  }
+  else c->valid[c->n/8]|=1<<(c->n%8);
+  if(c->len+len>INT32_MAX) errx(1, "arrow string column larger than 2GB, use a smaller --batch");
+  if(c->len+len>c->siz)
+  {
+    c->siz=(c->len+len)*2;
+    stats_realloc();
+    if(NULL==(c->data=realloc(c->data,c->siz))) err(1, "realloc");
+  }
+  for(d=c->data+c->len;str<end;str++)
+  {
+    *d++=*str;
+    if('"'==*str&&str+1<end&&'"'==str[1]) str++;
+  }
+  c->len=d-c->data;
+  c->offs[++c->n]=c->len;
+}
+
+static void arrow_body(struct outbuf *out, void const *buf, size_t len)
+{
+  static const char zero[8]={0};
+
+  if(len>0) outbuf_write(out,buf,len);
+  if(0!=len%8) outbuf_write(out,zero,8-len%8);
+}
+
+/* write the rows collected as a record batch
+ */
+static void arrow_batch(struct arrowbatch *ab, struct outbuf *out)
+{
+  struct arrowcol *c;
+  struct fbb b;
+  size_t hdr,len[3];
+  uint64_t off;
+  int i,j;
+
+  if(0==ab->rows) return;
+  memset(&b,0,sizeof(struct fbb));
+  for(i=0,off=0;i<ab->ncols;i++)
+  {
+    c=&ab->cols[i];
+    off+=(0==c->nnull?0:ALIGN8((ab->rows+7)/8))+ALIGN8((ab->rows+1)*sizeof(int32_t))+ALIGN8(c->len);
+  }
+  hdr=arrow_msghead(&b,3 /* RecordBatch */,off);
+  {
+    struct fbfld batch[]={{0,8,ab->rows,0},{1,4,0,0},{2,4,0,0}};
+    fb_patch(&b,hdr,fb_table(&b,batch,3));
+    fb_pad(&b,8,4);
+    fb_patch(&b,batch[1].pos,fb_int(&b,ab->ncols,4));
+    for(i=0;i<ab->ncols;i++)
+    {
+      fb_int(&b,ab->rows,8);
+      fb_int(&b,ab->cols[i].nnull,8);
+    }
+    fb_pad(&b,8,4);
+    fb_patch(&b,batch[2].pos,fb_int(&b,3*ab->ncols,4));
+  }
+  for(i=0,off=0;i<ab->ncols;i++)
+  {
+    c=&ab->cols[i];
+    len[0]=(0==c->nnull?0:(ab->rows+7)/8);
+    len[1]=(ab->rows+1)*sizeof(int32_t);
+    len[2]=c->len;
+    for(j=0;j<3;off+=ALIGN8(len[j++]))
+    {
+      fb_int(&b,off,8);
+      fb_int(&b,len[j],8);
+    }
+  }
+  arrow_message(out,&b);
+  free(b.buf);
+  for(i=0;i<ab->ncols;i++)
+  {
+    c=&ab->cols[i];
+    if(c->nnull>0) arrow_body(out,c->valid,(ab->rows+7)/8);
+    arrow_body(out,c->offs,(ab->rows+1)*sizeof(int32_t));
+    arrow_body(out,c->data,c->len);
+    c->n=c->nnull=0;
+    c->len=0;
+  }
+  ab->rows=0;
+}
+
+/* complete the current row with missing values, a full batch is written
+ */
+static void arrow_endrow(struct arrowbatch *ab, struct outbuf *out)
+{
+  int i;
+
+  ab->rows++;
+  for(i=0;i<ab->ncols;i++) if(ab->cols[i].n<ab->rows) arrow_value(ab,i,NULL,0);
+  if(ab->rows>=batchrows) arrow_batch(ab,out);
+}
+
+/* a value of a row, not terminated, str is NULL if the field is not selected
+ */
+struct slice
+{
+  char const *str;
+  size_t len;
+};
+
+/* bump allocator of the values made while cutting a row, it is reset for the next row
+   a row not fitting in the block gets extra blocks which are merged at the reset,
+   so a block big enough for every row is reached after a few rows
+ */
+struct arenablk
+{
+  struct arenablk *next;
+  char data[];
+};
+
+struct arena
+{
+  char *buf;
+  size_t len,siz;
+  struct arenablk *more;  /* blocks of the values not fitting in buf */
+  size_t need;            /* bytes used by the current row */
+};
+
+static void *arena_alloc(struct arena *a, size_t len)
+{
+  struct arenablk *b;
+
+  len=(len+7)&~(size_t)7;
+  a->need+=len;
+  if(a->len+len<=a->siz)
+  {
+    a->len+=len;
+    return(&a->buf[a->len-len]);
+  }
+  stats_realloc();
+  if(NULL==(b=malloc(sizeof(struct arenablk)+len))) err(1, "malloc");
+  b->next=a->more;
+  a->more=b;
+  return(b->data);
+}
+
+static void arena_reset(struct arena *a)
+{
+  struct arenablk *b;
+
+  if(NULL!=a->more)
+  {
+    while(NULL!=(b=a->more))
+    {
+      a->more=b->next;
+      free(b);
+    }
+    while(a->siz<a->need) a->siz=(0==a->siz?FLDBUFSIZ*16:2*a->siz);
+    free(a->buf);
+    if(NULL==(a->buf=malloc(a->siz))) err(1, "malloc");
+  }
+  a->len=a->need=0;
+}
+
+static void arena_free(struct arena *a)
+{
+  a->need=0;
+  arena_reset(a);
+  if(NULL!=a->buf) free(a->buf);
+  memset(a,0,sizeof(struct arena));
+}
+
+/* copy a value to the arena with a terminating \0
+ */
+static char *arena_strndup(struct arena *a, char const *str, size_t len)
+{
+  char *ret=arena_alloc(a,len+1);
+  memcpy(ret,str,len);
+  ret[len]='\0';
+  return(ret);
+}
+
+struct cutrow;
+
+/* output column of a -r list
+ */
+struct planop
+{
+  int fld;             /* input index, -1 for an empty field */
+  int cmbn;            /* COMBINE_* of the fields cmbn_flds[first..first+n) or 0 */
+  int first,n;
+};
+
+/* -f or -r compiled for the header of a file
+ */
+struct plan
+{
+  char *keep;          /* input indexes split into values */
+  int *idx;            /* the same in input order */
+  int nidx;
+  int nsplit;          /* fields tokenized, the rest of the record is skipped */
+  int span;            /* the output may be a copy of the record from the first to the last field */
+  int *cofld;          /* kept indexes with a callout */
+  int *coprcol;        /* and their output column */
+  int nco;
+  struct planop *ops;  /* output columns of -r */
+  int nops;
+  int *cmbn_flds;
+};
+
+/* header row of the file being processed, read only while the rows are cut
+ */
+struct cutfile
+{
+  char dchar;
+  int fldnum;
+  char **fields;
+  char **out_fields;
+  struct slice *jkeys; /* escaped "name":" of the json columns */
+  char *jkeybuf;
+  struct plan plan;
+  struct colcache *cc; /* data rows are taken from the cache if it is set */
+  struct groupby *gb;  /* the rows are aggregated instead of printed if it is set */
+  struct outbuf *out;  /* output of the file */
+  void (*prfld)(struct cutrow *, char const *, size_t, int, int, char const *);
+};
+
+/* scratch buffers of the row pipeline, one for each thread
+ */
+struct cutrow
+{
+  struct cutfile *cf;
+  struct outbuf *out;
+  struct ccsv_field *flds;
+  struct slice *values;
+  struct slice *procval;  /* values before their callouts */
+  struct arena *arena;    /* values made for the current row */
+  struct arena rowarena;
+  struct slice span;      /* the selected fields as they are in the record */
+  char *cofld;      /* output of the callout */
+  int cofldsiz;
+  char *cmd;        /* callout command line */
+  int cmdsiz;
+  char cmdbuf[FLDBUFSIZ];
+  struct coproc *co; /* coprocesses of this thread indexed by callout id */
+  struct pending *pend; /* coprocess requests of the current row */
+  int npend;
+  char *key;        /* cache key of the current callout */
+  size_t keylen,keysiz;
+  char *xfbuf[2];   /* results of the built-in transforms */
+  size_t xfsiz[2];
+  char const **argv; /* extra values passed to a plugin */
+  long rows;        /* data rows printed */
+  struct arrowbatch *ab; /* columns of -o arrow */
+  struct stats *st; /* --stats of this thread or NULL */
+  uint64_t tlast;   /* end of the last timed stage */
+};
+
+/* the time since the end of the previous stage is spent in this one
+ */
+static inline void stats_stage(struct cutrow *r, enum stage stage)
+{
+  uint64_t t;
+
+  if(NULL==r->st) return;
+  t=now_ns();
+  r->st->ns[stage]+=t-r->tlast;
+  r->tlast=t;
+}
+
+/* a coprocess callout started by one thread
+ */
+struct coproc
+{
+  pid_t pid;
+  int fd;           /* socket connected to the stdin and stdout of the process */
+  int dead;
+  char *wbuf;       /* requests not sent yet */
+  size_t wlen,wsiz;
+  char *rbuf;       /* responses received */
+  size_t rpos,rlen,rsiz;
+};
+
+/* field waiting for the response of a coprocess
+ */
+struct pending
+{
+  int col;
+  struct callout *c;
+  char *key;        /* cache key of the request */
+  size_t keylen;
+  uint64_t t0;      /* --stats, time of the request */
+};
+
+/* cached output of a callout, entries are in a hash table and an lru list
+ */
+struct memo
+{
+  char *key;
+  size_t keylen,keysiz;
+  char *val;
+  size_t vallen,valsiz;
+  uint64_t hash;
+  struct memo *hnext;
+  struct memo *prev,*next;
+};
+
+static struct memo **memotab=NULL;
+static struct memo *memolru=NULL; /* most recently used, the list is circular */
+static size_t memomax=0; /* number of cached outputs, 0 disables the cache */
+static size_t memocnt=0;
+static unsigned long memohit=0,memomiss=0;
+static pthread_mutex_t memomtx=PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_mutex_t cbmtx=PTHREAD_MUTEX_INITIALIZER; /* guards cb[] */
+
+/* length of the prefix which can be copied to a json string as it is
+ */
+static inline size_t json_plain(char const *str, size_t len)
+{
+  size_t i=0;
+  unsigned char c;
+
+#if defined(CCSV_X86) && defined(__SSE2__)
+  const __m128i q=_mm_set1_epi8('"');
+  const __m128i b=_mm_set1_epi8('\\');
+  const __m128i ctl=_mm_set1_epi8(0x1f);
+  __m128i v;
+  int m;
+  for(;i+16<=len;i+=16)
+  {
+    v=_mm_loadu_si128((const __m128i *)(str+i));
+    m=_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v,q),_mm_cmpeq_epi8(v,b)),_mm_cmpeq_epi8(_mm_min_epu8(v,ctl),v)));
+    if(0!=m) return(i+__builtin_ctz(m));
+  }
+#endif
+  for(;i<len;i++)
+  {
+    c=(unsigned char)str[i];
+    if(c<0x20||'"'==c||'\\'==c) break;
+  }
+  return(i);
+}
+
+/* write the field as the contents of a json string, the doubled quotes of csv are written once
+ */
+static void json_escape(struct outbuf *o, char const *str, size_t len)
+{
+  static const char hex[]="0123456789abcdef";
+  char const *end=str+len;
+  char u[6]={'\\','u','0','0'};
+  size_t n;
+  unsigned char c;
+
+  while(str<end)
+  {
+    n=json_plain(str,end-str);
+    if(n>0) outbuf_write(o,str,n);
+    if((str+=n)>=end) break;
+    switch(c=(unsigned char)*str++)
+    {
+      case '"':
+        outbuf_write(o,"\\\"",2);
+        if(str<end&&'"'==*str) str++;
+        break;
+      case '\\': outbuf_write(o,"\\\\",2); break;
+      case '\n': outbuf_write(o,"\\n",2); break;
+      case '\t': outbuf_write(o,"\\t",2); break;
+      case '\r': outbuf_write(o,"\\r",2); break;
+      case '\b': outbuf_write(o,"\\b",2); break;
+      case '\f': outbuf_write(o,"\\f",2); break;
+      default:
+        u[4]=hex[c>>4];
+        u[5]=hex[c&15];
+        outbuf_write(o,u,6);
+    }
+  }
+}
+
+static void xmltagsanitize(char *field)
+{
+  if(!isalpha(*field)) *field='_';
+  for(;*field;field++)
+  {
+    if(!isalnum(*field)) *field='_';
+  }
+}
+
+static void print_field_csv(struct cutrow *r, char const *field, size_t len, int col, int prcol, char const * fname)
+{
+  (void)col;
+  (void)fname;
+  if(prcol!=0) outbuf_putc(r->out,Dchar[0]);
+  if(!qflag) outbuf_putc(r->out,'"');
+  if(NULL!=field) outbuf_write(r->out,field,len);
+  if(!qflag) outbuf_putc(r->out,'"');
+}
+
+/* the keys are taken from the input column of -f and the output column of -r
+ */
+static void print_field_json(struct cutrow *r, char const *field, size_t len, int col, int prcol, char const * fname)
+{
+  struct slice *k=&r->cf->jkeys[NULL==reorder_fields?col:prcol];
+
+  (void)fname;
+  outbuf_putc(r->out,(prcol==0?'{':','));
+  outbuf_write(r->out,k->str,k->len);
+  if(NULL!=field) json_escape(r->out,field,len);
+  outbuf_putc(r->out,'"');
+}
+
+static void print_field_xml(struct cutrow *r, char const *field, size_t len, int col, int prcol, char const * fname)
+{
+  char str[32];
+
+  (void)col;
+  if(prcol==0) outbuf_write(r->out,"<row>",5);
+  if(fname==NULL||strlen(fname)==0)
+  {
+    snprintf(str,sizeof(str),"column_%d",prcol);
+    fname=str;
+  }
+  outbuf_putc(r->out,'<');
+  outbuf_puts(r->out,fname);
+  outbuf_putc(r->out,'>');
+  if(NULL!=field) outbuf_write(r->out,field,len);
+  outbuf_write(r->out,"</",2);
+  outbuf_puts(r->out,fname);
+  outbuf_putc(r->out,'>');
+}
+
+static void print_field_arrow(struct cutrow *r, char const *field, size_t len, int col, int prcol, char const * fname)
+{
+  (void)col;
+  (void)fname;
+  arrow_value(r->ab,prcol,field,len);
+}
+
+/* separator printed before each row except the first one
+ */
+static void print_rowsep(struct outbuf *out)
+{
+  if(OT_JSON==otype) outbuf_putc(out,',');
+  else if(OT_XML==otype) outbuf_write(out,"</row>",6);
+}
+
+/* stop using the callout for a field after it failed
+ */
+static void callout_disable(int col, struct callout *c, char const *msg)
+{
+  pthread_mutex_lock(&cbmtx);
+  if(cb[col]==c)
+  {
+    fprintf(stderr,"%s '%s'\n",msg,c->cmd);
+    cb[col]=NULL;
+  }
+  pthread_mutex_unlock(&cbmtx);
+}
+
+static struct callout *get_callout(int col)
+{
+  struct callout *c=NULL;
+
+  pthread_mutex_lock(&cbmtx);
+  if(cbsize>col) c=cb[col];
+  pthread_mutex_unlock(&cbmtx);
+  return(c);
+}
+
+/* build the shell command line of a callout in r->cmd
+ */
+static void callout_cmdline(struct cutrow *r, struct callout *c, char const *field, int col, int prcol, char const *fname, struct slice *values)
+{
+  int cs,i;
+
+  if(r->cmd==NULL)
+  {
+    r->cmd=r->cmdbuf;
+    r->cmdsiz=sizeof(r->cmdbuf);
+  }
+  cs=1+snprintf(r->cmd,r->cmdsiz,"%s %d %d \"%s\" \"%s\"",c->cmd,col,prcol,fname,field);
+  for(i=0;i<cb_pass_fld_max;i++)
+  {
+    if(cb_pass_fld[i]!=0&&values[i].str!=NULL) cs+=3+values[i].len;
+  }
+  if(cs>r->cmdsiz)
+  {
+    cs*=2;
+    if(r->cmd!=r->cmdbuf) free(r->cmd);
+    stats_realloc();
+    if(NULL==(r->cmd=malloc(cs))) err(1, "malloc");
+    r->cmdsiz=cs;
+    snprintf(r->cmd,r->cmdsiz,"%s %d %d \"%s\" \"%s\"",c->cmd,col,prcol,fname,field);
+  }
+  for(i=0;i<cb_pass_fld_max;i++)
+  {
+    if(cb_pass_fld[i]!=0&&values[i].str!=NULL)
+    {
+      strcat(r->cmd," \"");
+      strcat(r->cmd,values[i].str);
+      strcat(r->cmd,"\"");
+    }
+  }
+}
+
+static char const *check_callout(struct cutrow *r, struct callout *c, char const *field, int col, int prcol, char const *fname, struct slice *values, int valuescnt)
+{
+  char const *ret=field;
+  int ln,l;
+  FILE *p;
+  
+  (void)valuescnt;
+  if(r->cofld==NULL)
+  {
+    r->cofldsiz=FLDBUFSIZ+1;
+    if(NULL==(r->cofld=malloc(r->cofldsiz))) err(1, "malloc");
+    r->cofld[0]='\0';
+  }
+  callout_cmdline(r,c,field,col,prcol,fname,values);
+  if((p=popen(r->cmd,"r")))
+  {
+    for(ln=0;0<(l=fread(&r->cofld[ln],1,r->cofldsiz-1-ln,p));)
+    {
+      ln+=l;
+      if(ln==r->cofldsiz-1)
+      {
+        r->cofldsiz+=FLDBUFSIZ;
+        stats_realloc();
+        if(NULL==(r->cofld=realloc(r->cofld,r->cofldsiz))) err(1, "realloc");
+      }
+    }
+    if(0!=(pclose(p))) callout_disable(col,c,"Failed to call");
+    else if(ln>0)
+    {
+      r->cofld[ln]='\0';
+      ret=r->cofld;
+    }
+  }
+  else callout_disable(col,c,"Cannot open");
+  
+  return(ret);
+}
+
+/* call the function of a plugin, the output goes to the callout buffer
+ */
+static char const *plugin_call(struct cutrow *r, struct callout *c, char const *field, int col, int prcol, char const *fname, struct slice *values)
+{
+  size_t len;
+  int i,argc;
+
+  if(r->cofld==NULL)
+  {
+    r->cofldsiz=FLDBUFSIZ+1;
+    if(NULL==(r->cofld=malloc(r->cofldsiz))) err(1, "malloc");
+  }
+  for(argc=i=0;i<cb_pass_fld_max;i++) if(cb_pass_fld[i]!=0&&values[i].str!=NULL) r->argv[argc++]=values[i].str;
+  r->argv[argc]=NULL;
+  len=r->cofldsiz-1;
+  if(0==c->fn(c->state,col,prcol,(NULL==fname?"":fname),field,argc,r->argv,r->cofld,&len)&&len>(size_t)r->cofldsiz-1)
+  {
+    r->cofldsiz=len+1;
+    stats_realloc();
+    if(NULL==(r->cofld=realloc(r->cofld,r->cofldsiz))) err(1, "realloc");
+    if(0!=c->fn(c->state,col,prcol,(NULL==fname?"":fname),field,argc,r->argv,r->cofld,&len)||len>(size_t)r->cofldsiz-1) len=(size_t)-1;
+  }
+  else if(len>(size_t)r->cofldsiz-1) len=(size_t)-1;
+  if((size_t)-1==len)
+  {
+    callout_disable(col,c,"Failed to call");
+    return(field);
+  }
+  if(0==len) return(field);
+  r->cofld[len]='\0';
+  return(r->cofld);
+}
+
+static char *xform_reserve(struct cutrow *r, int b, size_t len)
+{
+  if(len+1>r->xfsiz[b])
+  {
+    r->xfsiz[b]=2*(len+1);
+    stats_realloc();
+    if(NULL==(r->xfbuf[b]=realloc(r->xfbuf[b],r->xfsiz[b]))) err(1, "realloc");
+  }
+  return(r->xfbuf[b]);
+}
+
+/* run the built-in transforms of a callout on a field
+   each step reads the result of the previous one and writes the other buffer of the row
+ */
+static char *xform_apply(struct cutrow *r, struct callout *c, char const *field, size_t *flen, struct slice *values)
+{
+  struct xform *x;
+  char const *src=field,*p,*q;
+  char *dst;
+  size_t len=*flen,n,i;
+  long st;
+  int b,k;
+
+  for(b=k=0;k<c->nxf;k++,b^=1)
+  {
+    x=&c->xf[k];
+    switch(x->op)
+    {
+      case XF_UPPER:
+      case XF_LOWER:
+        dst=xform_reserve(r,b,len);
+        if(XF_UPPER==x->op) for(i=0;i<len;i++) dst[i]=toupper((unsigned char)src[i]);
+        else for(i=0;i<len;i++) dst[i]=tolower((unsigned char)src[i]);
+        break;
+      case XF_TRIM:
+        for(p=src;p<src+len&&CCSV_ISSPACE(*p);p++);
+        for(q=src+len;q>p&&CCSV_ISSPACE(q[-1]);q--);
+        len=q-p;
+        dst=xform_reserve(r,b,len);
+        memcpy(dst,p,len);
+        break;
+      case XF_SUBSTR:
+        st=(x->a<0?(long)len+x->a:x->a);
+        if(st<0) st=0;
+        if((size_t)st>len) st=len;
+        n=len-st;
+        if(x->b>=0&&(size_t)x->b<n) n=x->b;
+        dst=xform_reserve(r,b,n);
+        memcpy(dst,&src[st],n);
+        len=n;
+        break;
+      case XF_PREFIX:
+        dst=xform_reserve(r,b,x->l1+len);
+        memcpy(dst,x->s1,x->l1);
+        memcpy(&dst[x->l1],src,len);
+        len+=x->l1;
+        break;
+      case XF_SUFFIX:
+        dst=xform_reserve(r,b,len+x->l1);
+        memcpy(dst,src,len);
+        memcpy(&dst[len],x->s1,x->l1);
+        len+=x->l1;
+        break;
+      case XF_REPLACE:
+        for(n=len,p=src;NULL!=(q=strstr(p,x->s1));p=q+x->l1) n+=x->l2-x->l1;
+        dst=xform_reserve(r,b,n);
+        for(p=src;NULL!=(q=strstr(p,x->s1));p=q+x->l1)
+        {
+          memcpy(dst,p,q-p);
+          dst+=q-p;
+          memcpy(dst,x->s2,x->l2);
+          dst+=x->l2;
+        }
+        memcpy(dst,p,src+len-p);
+        len=n;
+        break;
+      case XF_JOIN:
+        for(n=len,i=0;i<(size_t)cb_pass_fld_max;i++) if(cb_pass_fld[i]!=0&&values[i].str!=NULL) n+=x->l1+values[i].len;
+        dst=xform_reserve(r,b,n);
+        memcpy(dst,src,len);
+        for(i=0;i<(size_t)cb_pass_fld_max;i++)
+        {
+          if(cb_pass_fld[i]!=0&&values[i].str!=NULL)
+          {
+            memcpy(&dst[len],x->s1,x->l1);
+            len+=x->l1;
+            memcpy(&dst[len],values[i].str,values[i].len);
+            len+=values[i].len;
+          }
+        }
+        break;
+    }
+    r->xfbuf[b][len]='\0';
+    src=r->xfbuf[b];
+  }
+  *flen=len;
+  return((char *)src);
+}
+
+static void coproc_start(struct coproc *co, char *cmd)
+{
+  int sv[2];
+
+  if(0!=socketpair(AF_UNIX,SOCK_STREAM|SOCK_CLOEXEC,0,sv)) err(1, "socketpair");
+  if(0>(co->pid=fork())) err(1, "fork");
+  if(0==co->pid)
+  {
+    if(0>dup2(sv[1],STDIN_FILENO)||0>dup2(sv[1],STDOUT_FILENO)) _exit(127);
+    execl("/bin/sh","sh","-c",cmd,(char *)NULL);
+    _exit(127);
+  }
+  close(sv[1]);
+  co->fd=sv[0];
+  if(0>fcntl(co->fd,F_SETFL,fcntl(co->fd,F_GETFL)|O_NONBLOCK)) err(1, "fcntl");
+}
+
+static void coproc_stop(struct coproc *co)
+{
+  int st;
+
+  if(0==co->pid) return;
+  shutdown(co->fd,SHUT_WR);
+  close(co->fd);
+  while(0>waitpid(co->pid,&st,0)&&EINTR==errno);
+  if(NULL!=co->wbuf) free(co->wbuf);
+  if(NULL!=co->rbuf) free(co->rbuf);
+  memset(co,0,sizeof(struct coproc));
+}
+
+static void coproc_put(struct coproc *co, char const *str, size_t len, int nl)
+{
+  if(co->wlen+len+1>co->wsiz)
+  {
+    co->wsiz=2*(co->wlen+len+1);
+    stats_realloc();
+    if(NULL==(co->wbuf=realloc(co->wbuf,co->wsiz))) err(1, "realloc");
+  }
+  memcpy(&co->wbuf[co->wlen],str,len);
+  co->wlen+=len;
+  if(nl) co->wbuf[co->wlen++]='\n';
+}
+
+static void coproc_putarg(struct coproc *co, char const *str, size_t len)
+{
+  char num[32];
+
+  coproc_put(co,num,snprintf(num,sizeof(num),"%zu",len),1);
+  coproc_put(co,str,len,1);
+}
+
+/* queue the request for one field:
+   "<argc>\n" followed by each argument as "<length>\n<bytes>\n"
+ */
+static void coproc_request(struct coproc *co, int col, int prcol, char const *fname, struct slice *field, struct slice *values)
+{
+  char num[32];
+  int i,argc;
+
+  for(argc=4,i=0;i<cb_pass_fld_max;i++) if(cb_pass_fld[i]!=0&&values[i].str!=NULL) argc++;
+  coproc_put(co,num,snprintf(num,sizeof(num),"%d",argc),1);
+  coproc_putarg(co,num,snprintf(num,sizeof(num),"%d",col));
+  coproc_putarg(co,num,snprintf(num,sizeof(num),"%d",prcol));
+  coproc_putarg(co,(NULL==fname?"":fname),(NULL==fname?0:strlen(fname)));
+  coproc_putarg(co,field->str,field->len);
+  for(i=0;i<cb_pass_fld_max;i++) if(cb_pass_fld[i]!=0&&values[i].str!=NULL) coproc_putarg(co,values[i].str,values[i].len);
+}
+
+/* wait for the next response "<status> <length>\n<bytes>"
+   while sending the queued requests
+   returns the status or -1 if the process is gone
+ */
+static int coproc_response(struct coproc *co, char **res, size_t *len)
+{
+  struct pollfd pfd;
+  char *nl;
+  ssize_t n;
+  long st;
+  size_t hl;
+
+  while(!co->dead)
+  {
+    if(co->rlen>co->rpos&&NULL!=(nl=memchr(&co->rbuf[co->rpos],'\n',co->rlen-co->rpos)))
+    {
+      if(2!=sscanf(&co->rbuf[co->rpos],"%ld %zu",&st,len))
+      {
+        co->dead=1;
+        break;
+      }
+      hl=nl+1-&co->rbuf[co->rpos];
+      if(co->rlen-co->rpos-hl>=*len)
+      {
+        *res=nl+1;
+        co->rpos+=hl+*len;
+        return(st<0?1:(int)st);
+      }
+    }
+    if(co->rpos>0)
+    {
+      memmove(co->rbuf,&co->rbuf[co->rpos],co->rlen-co->rpos);
+      co->rlen-=co->rpos;
+      co->rpos=0;
+    }
+    if(co->rlen==co->rsiz)
+    {
+      co->rsiz=(0==co->rsiz?INBUFSIZ:co->rsiz*2);
+      stats_realloc();
+      if(NULL==(co->rbuf=realloc(co->rbuf,co->rsiz))) err(1, "realloc");
+    }
+    pfd.fd=co->fd;
+    pfd.events=POLLIN|(co->wlen>0?POLLOUT:0);
+    if(0>poll(&pfd,1,-1))
+    {
+      if(EINTR==errno) continue;
+      err(1, "poll");
+    }
+    if(0!=(pfd.revents&POLLOUT))
+    {
+      if(0<(n=send(co->fd,co->wbuf,co->wlen,MSG_NOSIGNAL)))
+      {
+        memmove(co->wbuf,&co->wbuf[n],co->wlen-n);
+        co->wlen-=n;
+      }
+      else if(EAGAIN!=errno&&EINTR!=errno) co->dead=1;
+    }
+    if(0!=(pfd.revents&(POLLIN|POLLHUP|POLLERR)))
+    {
+      n=read(co->fd,&co->rbuf[co->rlen],co->rsiz-co->rlen);
+      if(n>0) co->rlen+=n;
+      else if(0==n||(EAGAIN!=errno&&EINTR!=errno)) co->dead=1;
+    }
+  }
+  return(-1);
+}
+
+static uint64_t memo_hash(char const *key, size_t len)
+{
+  uint64_t h=14695981039346656037ULL;
+  while(len-->0) h=(h^(unsigned char)*key++)*1099511628211ULL;
+  return(h);
+}
+
+static void memo_keyadd(struct cutrow *r, char const *str, size_t len)
+{
+  if(r->keylen+len+1>r->keysiz)
+  {
+    r->keysiz=2*(r->keylen+len+1);
+    stats_realloc();
+    if(NULL==(r->key=realloc(r->key,r->keysiz))) err(1, "realloc");
+  }
+  memcpy(&r->key[r->keylen],str,len);
+  r->keylen+=len;
+  r->key[r->keylen++]='\0';
+}
+
+/* key of a callout: callout, columns, value and the extra fields
+ */
+static void memo_key(struct cutrow *r, struct callout *c, int col, int prcol, struct slice *values)
+{
+  char num[64];
+  int i;
+
+  r->keylen=0;
+  memo_keyadd(r,num,snprintf(num,sizeof(num),"%d %d %d",c->id,col,prcol));
+  memo_keyadd(r,values[col].str,values[col].len);
+  for(i=0;i<cb_pass_fld_max;i++)
+  {
+    if(cb_pass_fld[i]!=0&&values[i].str!=NULL) memo_keyadd(r,values[i].str,values[i].len);
+    else memo_keyadd(r,"",0);
+  }
+}
+
+static struct memo **memo_find(char const *key, size_t len, uint64_t h)
+{
+  struct memo **m;
+
+  for(m=&memotab[h%memomax];NULL!=*m;m=&(*m)->hnext)
+  {
+    if((*m)->hash==h&&(*m)->keylen==len&&0==memcmp((*m)->key,key,len)) break;
+  }
+  return(m);
+}
+
+static void memo_unlink(struct memo *m)
+{
+  if(m->next==m) memolru=NULL;
+  else
+  {
+    m->prev->next=m->next;
+    m->next->prev=m->prev;
+    if(memolru==m) memolru=m->next;
+  }
+}
+
+static void memo_front(struct memo *m)
+{
+  if(NULL==memolru) m->prev=m->next=m;
+  else
+  {
+    m->next=memolru;
+    m->prev=memolru->prev;
+    m->prev->next=m;
+    memolru->prev=m;
+  }
+  memolru=m;
+}
+
+/* copy the cached output to the arena of the row, returns 0 if it is not cached
+ */
+static int memo_get(struct cutrow *r, char const *key, size_t len, struct slice *val)
+{
+  struct memo *m;
+  int ret=0;
+
+  pthread_mutex_lock(&memomtx);
+  if(NULL!=(m=*memo_find(key,len,memo_hash(key,len))))
+  {
+    memo_unlink(m);
+    memo_front(m);
+    val->str=arena_strndup(r->arena,m->val,m->vallen);
+    val->len=m->vallen;
+    memohit++;
+    ret=1;
+  }
+  else memomiss++;
+  pthread_mutex_unlock(&memomtx);
+  return(ret);
+}
+
+static void memo_put(char const *key, size_t len, char const *val, size_t vallen)
+{
+  struct memo *m,**mp;
+  uint64_t h=memo_hash(key,len);
+
+  pthread_mutex_lock(&memomtx);
+  if(NULL==*(mp=memo_find(key,len,h)))
+  {
+    if(memocnt<memomax)
+    {
+      if(NULL==(m=calloc(1,sizeof(struct memo)))) err(1, "calloc");
+      memocnt++;
+    }
+    else
+    {
+      /* reuse the least recently used entry */
+      struct memo **o;
+      m=memolru->prev;
+      memo_unlink(m);
+      for(o=&memotab[m->hash%memomax];*o!=m;o=&(*o)->hnext);
+      *o=m->hnext;
+      mp=memo_find(key,len,h);
+    }
+    if(len>m->keysiz&&NULL==(m->key=realloc(m->key,m->keysiz=len))) err(1, "realloc");
+    if(vallen>=m->valsiz&&NULL==(m->val=realloc(m->val,m->valsiz=vallen+1))) err(1, "realloc");
+    memcpy(m->key,key,len);
+    memcpy(m->val,val,vallen);
+    m->keylen=len;
+    m->vallen=vallen;
+    m->hash=h;
+    m->hnext=NULL;
+    *mp=m;
+    memo_front(m);
+  }
+  pthread_mutex_unlock(&memomtx);
+}
+
+static void setup_memo(char *arg)
+{
+  struct memo *m;
+
+  if(NULL==arg)
+  {
+    if(0<memomax) fprintf(stderr,"callout cache: %lu hits, %lu misses\n",memohit,memomiss);
+    while(NULL!=(m=memolru))
+    {
+      memo_unlink(m);
+      free(m->key);
+      free(m->val);
+      free(m);
+    }
+    if(NULL!=memotab) free(memotab);
+    memotab=NULL;
+    memomax=memocnt=0;
+    return;
+  }
+  memomax=strtoul(arg,NULL,10);
+  if(memomax>0&&NULL==(memotab=calloc(memomax,sizeof(struct memo *)))) err(1, "calloc");
+}
+
+/* collect the responses for the queued requests in order
+ */
+static void callout_wait(struct cutrow *r)
+{
+  struct pending *pd;
+  char *res;
+  size_t len;
+  int i,st;
+
+  for(i=0;i<r->npend;i++)
+  {
+    pd=&r->pend[i];
+    st=coproc_response(&r->co[pd->c->id],&res,&len);
+    if(statsflag) stats_callout(pd->c,pd->t0);
+    if(0!=st) callout_disable(pd->col,pd->c,"Failed to call");
+    else
+    {
+      if(NULL!=pd->key) memo_put(pd->key,pd->keylen,(len>0?res:r->values[pd->col].str),(len>0?len:r->values[pd->col].len));
+      if(len>0)
+      {
+        r->procval[pd->col]=r->values[pd->col];
+        r->values[pd->col].str=arena_strndup(r->arena,res,len);
+        r->values[pd->col].len=len;
+      }
+    }
+    pd->key=NULL;
+  }
+  r->npend=0;
+}
+
+/* a value as a \0 terminated string, copied to the arena unless it is terminated in place
+ */
+static char const *value_str(struct cutrow *r, struct slice *v)
+{
+  if(NULL!=v->str&&'\0'!=v->str[v->len]) v->str=arena_strndup(r->arena,v->str,v->len);
+  return(v->str);
+}
+
+/* replace the value of a field by the output of its callout
+   requests to coprocesses are only queued and answered by callout_wait()
+ */
+static void run_callout(struct cutrow *r, int col, int prcol, char const *fname, struct slice *values)
+{
+  struct callout *c;
+  struct coproc *co;
+  char const *f;
+  size_t len;
+  uint64_t t0=0;
+  int i;
+
+  if(cb==NULL||NULL==(c=get_callout(col))) return;
+  for(i=0;i<r->npend;i++)
+  {
+    /* the extra arguments have to be final */
+    if(r->pend[i].col<cb_pass_fld_max&&0!=cb_pass_fld[r->pend[i].col])
+    {
+      callout_wait(r);
+      break;
+    }
+  }
+  /* the commands get \0 terminated strings */
+  value_str(r,&values[col]);
+  for(i=0;i<cb_pass_fld_max;i++) if(cb_pass_fld[i]!=0) value_str(r,&values[i]);
+  if(statsflag) t0=now_ns();
+  if(CO_BUILTIN==c->type)
+  {
+    /* cheaper than a cache lookup */
+    len=values[col].len;
+    f=xform_apply(r,c,values[col].str,&len,values);
+    if(statsflag) stats_callout(c,t0);
+    r->procval[col]=values[col];
+    values[col].str=arena_strndup(r->arena,f,len);
+    values[col].len=len;
+    return;
+  }
+  if(memomax>0)
+  {
+    memo_key(r,c,col,prcol,values);
+    r->procval[col]=values[col];
+    if(memo_get(r,r->key,r->keylen,&values[col]))
+    {
+      if(statsflag) __atomic_add_fetch(&c->hits,1,__ATOMIC_RELAXED);
+      return;
+    }
+  }
+  if(CO_COPROC==c->type)
+  {
+    co=&r->co[c->id];
+    if(0==co->pid) coproc_start(co,c->cmd);
+    coproc_request(co,col,prcol,fname,&values[col],values);
+    r->pend[r->npend].col=col;
+    r->pend[r->npend].c=c;
+    r->pend[r->npend].key=NULL;
+    r->pend[r->npend].t0=t0;
+    if(memomax>0)
+    {
+      r->pend[r->npend].key=arena_strndup(r->arena,r->key,r->keylen);
+      r->pend[r->npend].keylen=r->keylen;
+    }
+    r->npend++;
+    return;
+  }
+  if(CO_PLUGIN==c->type) f=plugin_call(r,c,values[col].str,col,prcol,fname,values);
+  else f=check_callout(r,c,values[col].str,col,prcol,fname,values,r->cf->fldnum);
+  if(statsflag) stats_callout(c,t0);
+  len=strlen(f);
+  if(memomax>0&&get_callout(col)==c) memo_put(r->key,r->keylen,f,len);
+  r->procval[col]=values[col];
+  if(f!=values[col].str)
+  {
+    values[col].str=arena_strndup(r->arena,f,len);
+    values[col].len=len;
+  }
+}
+
+static void cutrow_init(struct cutrow *r, struct cutfile *cf, struct outbuf *out)
+{
+  memset(r,0,sizeof(struct cutrow));
+  r->cf=cf;
+  r->out=out;
+  r->flds=calloc(cf->fldnum,sizeof(struct ccsv_field));
+  r->values=calloc(cf->fldnum,sizeof(struct slice));
+  r->procval=calloc(cf->fldnum,sizeof(struct slice));
+  r->arena=&r->rowarena;
+  r->co=calloc(ncallouts+1,sizeof(struct coproc));
+  r->pend=calloc(cf->fldnum,sizeof(struct pending));
+  r->argv=calloc(cb_pass_fld_max+1,sizeof(char *));
+  if(NULL==r->flds||NULL==r->values||NULL==r->procval||NULL==r->co||NULL==r->pend||NULL==r->argv) err(1, "calloc");
+  if(OT_ARROW==otype)
+  {
+    if(NULL==(r->ab=malloc(sizeof(struct arrowbatch)))) err(1, "malloc");
+    arrow_init(r->ab,(NULL==reorder_fields?cf->plan.nidx:cf->plan.nops));
+  }
+  if(statsflag)
+  {
+    if(NULL==(r->st=calloc(1,sizeof(struct stats)))) err(1, "calloc");
+    r->tlast=now_ns();
+  }
+}
+
+static void cutrow_free(struct cutrow *r)
+{
+  int i;
+
+  if(NULL!=r->co)
+  {
+    for(i=0;i<ncallouts;i++) coproc_stop(&r->co[i]);
+    free(r->co);
+  }
+  if(NULL!=r->pend) free(r->pend);
+  if(NULL!=r->argv) free(r->argv);
+  if(NULL!=r->ab)
+  {
+    arrow_free(r->ab);
+    free(r->ab);
+  }
+  if(NULL!=r->st)
+  {
+    stats_merge(r->st);
+    free(r->st);
+  }
+  if(NULL!=r->key) free(r->key);
+  if(NULL!=r->flds) free(r->flds);
+  if(NULL!=r->values) free(r->values);
+  if(NULL!=r->procval) free(r->procval);
+  arena_free(&r->rowarena);
+  if(NULL!=r->cofld) free(r->cofld);
+  if(NULL!=r->xfbuf[0]) free(r->xfbuf[0]);
+  if(NULL!=r->xfbuf[1]) free(r->xfbuf[1]);
+  if(NULL!=r->cmd&&r->cmd!=r->cmdbuf) free(r->cmd);
+  memset(r,0,sizeof(struct cutrow));
+}
+
+static struct planop *plan_op(struct plan *pl, int fld)
+{
+  struct planop *op;
+
+  if(NULL==(pl->ops=realloc(pl->ops,(pl->nops+1)*sizeof(struct planop)))) err(1, "realloc");
+  op=&pl->ops[pl->nops++];
+  memset(op,0,sizeof(struct planop));
+  op->fld=fld;
+  if(fld>=0) pl->keep[fld]=1;
+  return(op);
+}
+
+/* compile -f or -r for the number of fields of the header
+   -r lists are flattened to output columns, ranges open to the right are expanded
+   and columns not in the header are dropped, so the columns are numbered without gaps
+ */
+static void plan_compile(struct cutfile *cf)
+{
+  struct plan *pl=&cf->plan;
+  struct planop *grp=NULL;
+  int fldnum=cf->fldnum;
+  int i,j,v,n;
+
+  memset(pl,0,sizeof(struct plan));
+  pl->keep=calloc(fldnum,1);
+  pl->idx=calloc(fldnum,sizeof(int));
+  pl->cofld=calloc(fldnum,sizeof(int));
+  pl->coprcol=calloc(fldnum,sizeof(int));
+  if(NULL==pl->keep||NULL==pl->idx||NULL==pl->cofld||NULL==pl->coprcol) err(1, "calloc");
+  if(NULL==reorder_fields)
+  {
+    for(i=0;i<fldnum;i++) pl->keep[i]=(gflag?0:(NULL==positions||(autostop>1&&autostop<(size_t)(i+1))||(maxval>(size_t)i&&positions[i+1]!=0)));
+    /* the key and the aggregated fields of -g and -a */
+    for(i=0;gflag&&i<ngrpcols;i++) if(grpcols[i]<fldnum) pl->keep[grpcols[i]]=1;
+    for(i=0;gflag&&i<naggs;i++) if(aggs[i].col>=0&&aggs[i].col<fldnum) pl->keep[aggs[i].col]=1;
+  }
+  else
+  {
+    for(n=0;0!=reorder_fields[n];n++);
+    if(NULL==(pl->cmbn_flds=calloc(n+1,sizeof(int)))) err(1, "calloc");
+    for(i=0,n=0;0!=(v=reorder_fields[i]);i++)
+    {
+      if(v<=COMBINES_MAX)
+      {
+        /* the fields of a combined column are marked by the type, except the last one */
+        if(NULL==grp)
+        {
+          grp=plan_op(pl,-1);
+          grp->cmbn=v;
+          grp->first=n;
+        }
+        v=reorder_fields[++i];
+        if(v>0&&v<=fldnum) pl->keep[pl->cmbn_flds[n++]=v-1]=1;
+        continue;
+      }
+      if(NULL!=grp)
+      {
+        if(v>0&&v<=fldnum) pl->keep[pl->cmbn_flds[n++]=v-1]=1;
+        grp=&pl->ops[pl->nops-1];
+        grp->n=n-grp->first;
+        if(0==grp->n) pl->nops--;
+        grp=NULL;
+      }
+      else if(INF==v) plan_op(pl,-1);
+      else if(v>0&&v<=fldnum) plan_op(pl,v-1);
+      else if(v<0) for(j=-v;j<=fldnum;j++) plan_op(pl,j-1);
+    }
+    /* fields with a callout may be passed to other callouts */
+    for(i=0;i<fldnum;i++) if((i<cbsize&&NULL!=cb[i])||(i<cb_pass_fld_max&&0!=cb_pass_fld[i])) pl->keep[i]=1;
+    if(OT_JSON==otype||OT_NDJSON==otype)
+    {
+      char str[32];
+      if(NULL==(cf->out_fields=calloc(pl->nops+1,sizeof(char *)))) err(1, "calloc");
+      for(i=0;i<pl->nops;i++)
+      {
+        snprintf(str,sizeof(str),"%d",i+1);
+        if(NULL==(cf->out_fields[i]=strdup(str))) err(1, "strdup");
+      }
+    }
+  }
+  for(i=0;i<fldnum;i++)
+  {
+    if(!pl->keep[i]) continue;
+    if(i<cbsize&&NULL!=cb[i])
+    {
+      /* callouts see the output column of -f and the input column of -r */
+      pl->cofld[pl->nco]=i;
+      pl->coprcol[pl->nco++]=(NULL==reorder_fields?pl->nidx:i);
+    }
+    pl->idx[pl->nidx++]=i;
+    pl->nsplit=i+1;
+  }
+  /* filtered fields are tokenized but not kept */
+  if(pl->nsplit<wfldmax) pl->nsplit=(wfldmax<fldnum?wfldmax:fldnum);
+  /* consecutive fields printed as csv with the input delimiter and quoting are not rewritten */
+  pl->span=(!gflag&&NULL==reorder_fields&&OT_CSV==otype&&Dchar[0]==cf->dchar&&0==pl->nco&&pl->nidx>0&&pl->idx[pl->nidx-1]-pl->idx[0]==pl->nidx-1);
+}
+
+static void plan_free(struct plan *pl)
+{
+  if(NULL!=pl->keep) free(pl->keep);
+  if(NULL!=pl->idx) free(pl->idx);
+  if(NULL!=pl->cofld) free(pl->cofld);
+  if(NULL!=pl->coprcol) free(pl->coprcol);
+  if(NULL!=pl->ops) free(pl->ops);
+  if(NULL!=pl->cmbn_flds) free(pl->cmbn_flds);
+  memset(pl,0,sizeof(struct plan));
+}
+
+static int filter_pred(struct cutrow *r, struct wpred *p, char const *str, size_t len)
+{
+  regmatch_t m;
+  char num[64];
+  char *end;
+  double d;
+
+  (void)r;
+  switch(p->op)
+  {
+    case W_EQ:
+      return(len==p->len&&0==memcmp(str,p->str,len));
+    case W_NE:
+      return(!(len==p->len&&0==memcmp(str,p->str,len)));
+    case W_PREFIX:
+      return(len>=p->len&&0==memcmp(str,p->str,p->len));
+    case W_MATCH:
+    case W_NOMATCH:
+#ifdef REG_STARTEND
+      m.rm_so=0;
+      m.rm_eo=len;
+      return((0==regexec(&p->re,str,1,&m,REG_STARTEND))==(W_MATCH==p->op));
+#else
+      return((0==regexec(&p->re,arena_strndup(r->arena,str,len),1,&m,0))==(W_MATCH==p->op));
+#endif
+    default:
+      /* fields which are not a number never match */
+      if(0==len||len>=sizeof(num)) return(0);
+      memcpy(num,str,len);
+      num[len]='\0';
+      d=strtod(num,&end);
+      if('\0'!=*end) return(0);
+      if(W_LT==p->op) return(d<p->num);
+      if(W_LE==p->op) return(d<=p->num);
+      if(W_GT==p->op) return(d>p->num);
+      return(d>=p->num);
+  }
+}
+
+/* evaluate the -w filters on the fields of a split record, missing fields are empty
+ */
+static int filter_row(struct cutrow *r, int nf)
+{
+  struct wexpr *w;
+  struct wpred *p;
+  int i,j,k,ok;
+
+  for(i=0;i<nfilters;i++)
+  {
+    w=&filters[i];
+    for(ok=0,p=w->p,j=0;!ok&&j<w->nterm;p+=w->term[j++])
+    {
+      for(ok=1,k=0;ok&&k<w->term[j];k++)
+      {
+        if(p[k].fld<nf) ok=filter_pred(r,&p[k],r->flds[p[k].fld].str,r->flds[p[k].fld].len);
+        else ok=filter_pred(r,&p[k],"",0);
+      }
+    }
+    if(!ok) return(0);
+  }
+  return(1);
+}
+
+/* fields of a cached row needed for the output and the filters, lineno 2 is the first row
+ */
+static int cache_split(struct cutrow *r, struct colcache *cc, long lineno)
+{
+  struct plan *pl=&r->cf->plan;
+  uint64_t row=lineno-2;
+  struct wpred *p;
+  int i,k,nf;
+
+  nf=cc->nf[row];
+  if(nf>pl->nsplit) nf=pl->nsplit;
+  for(k=0;k<pl->nidx;k++) if((i=pl->idx[k])<nf) cache_field(cc,i,row,&r->flds[i]);
+  for(i=0;i<nfilters;i++)
+  {
+    for(p=filters[i].p;p<&filters[i].p[filters[i].np];p++) if(p->fld<nf) cache_field(cc,p->fld,row,&r->flds[p->fld]);
+  }
+  return(nf);
+}
+
+/* set the span of the record printed for the fields of a -f range
+   each field has to be quoted if the output is quoted and unquoted otherwise,
+   with nothing but the quotes and a delimiter between them
+ */
+static int split_span(struct cutrow *r, char const *end)
+{
+  struct plan *pl=&r->cf->plan;
+  struct ccsv_field *f=&r->flds[pl->idx[0]];
+  struct ccsv_field *l=&r->flds[pl->idx[pl->nidx-1]];
+  char type=(qflag?r->cf->dchar:'"');
+  int gap=(qflag?1:3);
+
+  for(;f<l;f++) if(f->type!=type||f[1].str!=f->str+f->len+gap) return(0);
+  if(l->type!=type||(!qflag&&(l->str+l->len>=end||'"'!=l->str[l->len]))) return(0);
+  f=&r->flds[pl->idx[0]];
+  r->span.str=f->str-(qflag?0:1);
+  r->span.len=l->str+l->len+(qflag?0:1)-r->span.str;
+  return(1);
+}
+
+/* split a record into the selected values
+   fields after the last one needed are not tokenized
+   returns 0 for a row rejected by the filters, no values are set then
+ */
+static int split_row(struct cutrow *r, char *buf, size_t len, long lineno)
+{
+  struct cutfile *cf=r->cf;
+  char **fields=cf->fields;
+  char *keep=cf->plan.keep;
+  struct slice *values=r->values;
+  int i,nf;
+
+  // get line
+  if(lineno>1&&NULL!=cf->cc) nf=cache_split(r,cf->cc,lineno);
+  else nf=ccsv_split(buf,len,cf->dchar,r->flds,(1==lineno?cf->fldnum:cf->plan.nsplit));
+  if(NULL!=r->st)
+  {
+    r->st->records++;
+    stats_stage(r,ST_TOKENIZE);
+  }
+  if(lineno>1&&nfilters>0&&!filter_row(r,nf))
+  {
+    stats_stage(r,ST_PROJECT);
+    return(0);
+  }
+  if(lineno>1&&cf->plan.span&&NULL==cf->cc&&nf>cf->plan.idx[cf->plan.nidx-1]&&split_span(r,buf+len))
+  {
+    stats_stage(r,ST_PROJECT);
+    return(1);
+  }
+  for(i=0;i<nf;i++)
+  {
+    if(1==lineno)
+    {
+      fields[i]=strndup(r->flds[i].str,r->flds[i].len);
+      if(NULL==fields[i]) err(1, "strndup");
+      if(OT_XML==otype) xmltagsanitize(fields[i]);
+      if(Hflag) continue;
+    }
+    if(keep[i])
+    {
+      values[i].str=r->flds[i].str;
+      values[i].len=r->flds[i].len;
+    }
+  }
+  stats_stage(r,ST_PROJECT);
+  return(1);
+}
+
+static void group_row(struct cutrow *r);
+
+/* print the values of a row and clear them
+ */
+static void print_row(struct cutrow *r, long lineno)
+{
+  struct cutfile *cf=r->cf;
+  void (*prfld)(struct cutrow *, char const *, size_t, int, int, char const *)=cf->prfld;
+  struct plan *pl=&cf->plan;
+  struct planop *op;
+  char **fields=cf->fields;
+  struct slice *values=r->values;
+  int *cmbn_flds;
+  int col,i,j,k;
+
+  if(NULL!=cf->gb)
+  {
+    if(lineno>1) group_row(r);
+    memset(r->values,0,pl->nsplit*sizeof(struct slice));
+    memset(r->procval,0,pl->nsplit*sizeof(struct slice));
+    return;
+  }
+  if(lineno>1&&r->rows++>0) print_rowsep(r->out);
+  if(lineno>1&&NULL!=r->st) r->st->rows++;
+  if(NULL!=r->span.str)
+  {
+    outbuf_write(r->out,r->span.str,r->span.len);
+    r->span.str=NULL;
+    col=pl->nidx;
+  }
+  else if(NULL==reorder_fields)
+  {
+    for(k=col=0;k<pl->nidx;k++)
+    {
+      i=pl->idx[k];
+      if(NULL!=values[i].str) prfld(r,values[i].str,values[i].len,i,col++,fields[i]);
+      else if(OT_ARROW==otype) col++; /* arrow columns do not shift */
+    }
+  }
+  else if(lineno>1||!Hflag)
+  {
+    for(col=0;col<pl->nops;col++)
+    {
+      op=&pl->ops[col];
+      cmbn_flds=&pl->cmbn_flds[op->first];
+      if(0==op->cmbn)
+      {
+        if(op->fld<0) prfld(r,"",0,0,col,"");
+        else prfld(r,values[op->fld].str,values[op->fld].len,op->fld,col,fields[op->fld]);
+      }
+      else if(COMBINE_LONGER==op->cmbn)
+      {
+        int maxj=cmbn_flds[0];
+        for(j=1;j<op->n;j++) if(values[cmbn_flds[j]].len>values[maxj].len) maxj=cmbn_flds[j];
+        prfld(r,values[maxj].str,values[maxj].len,maxj,col,fields[maxj]);
+      }
+      else
+      {
+        size_t len=0;
+        char *cmb;
+        for(j=0;j<op->n;j++) len+=values[cmbn_flds[j]].len;
+        cmb=arena_alloc(r->arena,len);
+        for(len=0,j=0;j<op->n;j++)
+        {
+          if(NULL!=values[cmbn_flds[j]].str) memcpy(&cmb[len],values[cmbn_flds[j]].str,values[cmbn_flds[j]].len);
+          len+=values[cmbn_flds[j]].len;
+        }
+        prfld(r,cmb,len,cmbn_flds[0],col,fields[cmbn_flds[0]]);
+      }
+    }
+  }
+  memset(r->values,0,pl->nsplit*sizeof(struct slice));
+  memset(r->procval,0,pl->nsplit*sizeof(struct slice));
+  if((OT_JSON==otype||OT_NDJSON==otype)&&lineno>1)
+  {
+    /* no field of the row was printed */
+    if(NULL==reorder_fields&&0==col) outbuf_putc(r->out,'{');
+    outbuf_putc(r->out,'}');
+  }
+  if(OT_ARROW==otype)
+  {
+    if(lineno>1) arrow_endrow(r->ab,r->out);
+  }
+  else if(!((Hflag&&lineno==1)||OT_JSON==otype)) outbuf_putc(r->out,'\n');
+  if(uflag) outbuf_flush(r->out);
+}
+
+/* write the arrow schema with the header names of the output columns
+ */
+static void arrow_names(struct cutfile *cf)
+{
+  struct plan *pl=&cf->plan;
+  struct planop *op;
+  char const **names;
+  int k,n;
+
+  n=(NULL==reorder_fields?pl->nidx:pl->nops);
+  if(NULL==(names=calloc(n+1,sizeof(char *)))) err(1, "calloc");
+  for(k=0;k<n;k++)
+  {
+    if(NULL==reorder_fields) names[k]=cf->fields[pl->idx[k]];
+    else
+    {
+      op=&pl->ops[k];
+      if(0!=op->cmbn) names[k]=cf->fields[pl->cmbn_flds[op->first]];
+      else if(op->fld>=0) names[k]=cf->fields[op->fld];
+    }
+  }
+  arrow_schema(cf->out,names,n);
+  free(names);
+}
+
+/* escape the json keys once, "name":" of each input column of -f or output column of -r
+ */
+static void json_keys(struct cutfile *cf)
+{
+  struct outbuf o;
+  char const *name;
+  size_t off;
+  int k,n;
+
+  n=(NULL==reorder_fields?cf->fldnum:cf->plan.nops);
+  if(NULL==(cf->jkeys=calloc(n+1,sizeof(struct slice)))) err(1, "calloc");
+  outbuf_init(&o,-1,64);
+  for(k=0;k<n;k++)
+  {
+    name=(NULL==reorder_fields?cf->fields[k]:cf->out_fields[k]);
+    off=o.len;
+    outbuf_putc(&o,'"');
+    if(NULL!=name) json_escape(&o,name,strlen(name));
+    outbuf_write(&o,"\":\"",3);
+    cf->jkeys[k].len=o.len-off;
+  }
+  /* the buffer may have moved while it grew */
+  for(off=0,k=0;k<n;off+=cf->jkeys[k++].len) cf->jkeys[k].str=o.buf+off;
+  cf->jkeybuf=o.buf;
+}
+
+/* -g and -a: the groups are kept in the order they are found, a hash table indexes them
+   the keys and aggregates are allocated from blocks which are freed together,
+   when the memory exceeds groupmem the partial aggregates are written to temporary
+   files by the hash of the key and merged one file after the other at the end
+ */
+struct aggval
+{
+  double d;
+  uint64_t n;     /* rows of count, numbers of the others */
+};
+
+struct group
+{
+  uint64_t hash;
+  char *key;      /* the key fields each followed by a \0 */
+  size_t keylen;
+  struct aggval *v;
+};
+
+/* slot of the hash table, the high bits of the hash save looking at other groups
+ */
+struct groupslot
+{
+  uint32_t idx;   /* index+1 of the group, 0 is empty */
+  uint32_t tag;
+};
+
+struct groupby
+{
+  struct group *grp;
+  size_t ngrp,grpsiz;
+  struct groupslot *tab;
+  size_t mask;
+  struct arenablk *blk;
+  size_t used,blksiz;
+  size_t mem;     /* bytes of the groups */
+  FILE *part[GROUPPARTS];
+  int spilled;
+};
+
+/* the low bits of the key hash index the table, they are mixed with the high ones
+ */
+static inline uint64_t group_hash(char const *key, size_t len)
+{
+  uint64_t h=memo_hash(key,len);
+
+  h^=h>>33;
+  h*=0xff51afd7ed558ccdULL;
+  h^=h>>33;
+  return(h);
+}
+
+static void *group_alloc(struct groupby *gb, size_t len)
+{
+  struct arenablk *b;
+
+  len=(len+7)&~(size_t)7;
+  if(NULL==gb->blk||gb->used+len>gb->blksiz)
+  {
+    gb->blksiz=(len>GROUPBLK?len:GROUPBLK);
+    stats_realloc();
+    if(NULL==(b=malloc(sizeof(struct arenablk)+gb->blksiz))) err(1, "malloc");
+    b->next=gb->blk;
+    gb->blk=b;
+    gb->used=0;
+    gb->mem+=sizeof(struct arenablk)+gb->blksiz;
+  }
+  gb->used+=len;
+  return(&gb->blk->data[gb->used-len]);
+}
+
+/* forget the groups, the table keeps its size
+ */
+static void group_reset(struct groupby *gb)
+{
+  struct arenablk *b;
+
+  while(NULL!=(b=gb->blk))
+  {
+    gb->blk=b->next;
+    free(b);
+  }
+  if(NULL!=gb->tab) memset(gb->tab,0,(gb->mask+1)*sizeof(struct groupslot));
+  gb->ngrp=gb->used=gb->blksiz=0;
+  gb->mem=(gb->mask+1)*sizeof(struct groupslot)+gb->grpsiz*sizeof(struct group);
+}
+
+/* the group of a key, a new one with empty aggregates if there is none
+ */
+static struct group *group_find(struct groupby *gb, char const *key, size_t keylen, uint64_t hash)
+{
+  struct group *g;
+  uint32_t tag=hash>>32;
+  size_t k,i;
+
+  for(k=hash&gb->mask;0!=(i=gb->tab[k].idx);k=(k+1)&gb->mask)
+  {
+    if(gb->tab[k].tag!=tag) continue;
+    g=&gb->grp[i-1];
+    if(g->hash==hash&&g->keylen==keylen&&0==memcmp(g->key,key,keylen)) return(g);
+  }
+  if(gb->ngrp>=UINT32_MAX) errx(1, "too many groups");
+  if(gb->ngrp==gb->grpsiz)
+  {
+    gb->mem-=gb->grpsiz*sizeof(struct group);
+    gb->grpsiz=(0==gb->grpsiz?1024:2*gb->grpsiz);
+    stats_realloc();
+    if(NULL==(gb->grp=realloc(gb->grp,gb->grpsiz*sizeof(struct group)))) err(1, "realloc");
+    gb->mem+=gb->grpsiz*sizeof(struct group);
+  }
+  g=&gb->grp[gb->ngrp++];
+  g->hash=hash;
+  g->keylen=keylen;
+  g->key=memcpy(group_alloc(gb,keylen),key,keylen);
+  g->v=group_alloc(gb,(naggs+1)*sizeof(struct aggval));
+  memset(g->v,0,(naggs+1)*sizeof(struct aggval));
+  gb->tab[k].idx=gb->ngrp;
+  gb->tab[k].tag=tag;
+  if(2*gb->ngrp>gb->mask)
+  {
+    /* at most half full */
+    gb->mem-=(gb->mask+1)*sizeof(struct groupslot);
+    free(gb->tab);
+    gb->mask=2*gb->mask+1;
+    stats_realloc();
+    if(NULL==(gb->tab=calloc(gb->mask+1,sizeof(struct groupslot)))) err(1, "calloc");
+    gb->mem+=(gb->mask+1)*sizeof(struct groupslot);
+    for(i=0;i<gb->ngrp;i++)
+    {
+      for(k=gb->grp[i].hash&gb->mask;0!=gb->tab[k].idx;k=(k+1)&gb->mask);
+      gb->tab[k].idx=i+1;
+      gb->tab[k].tag=gb->grp[i].hash>>32;
+    }
+  }
+  return(g);
+}
+
+static void group_init(struct cutfile *cf)
+{
+  if(NULL==(cf->gb=calloc(1,sizeof(struct groupby)))) err(1, "calloc");
+  cf->gb->mask=1023;
+  if(NULL==(cf->gb->tab=calloc(cf->gb->mask+1,sizeof(struct groupslot)))) err(1, "calloc");
+  group_reset(cf->gb);
+}
+
+static void group_free(struct groupby *gb)
+{
+  int i;
+
+  group_reset(gb);
+  for(i=0;i<GROUPPARTS;i++) if(NULL!=gb->part[i]) fclose(gb->part[i]);
+  if(NULL!=gb->tab) free(gb->tab);
+  if(NULL!=gb->grp) free(gb->grp);
+  free(gb);
+}
+
+/* merge the partial aggregates of the same key
+ */
+static void group_merge(struct aggval *v, struct aggval const *w)
+{
+  int i;
+
+  for(i=0;i<naggs;i++)
+  {
+    if(0==w[i].n) continue;
+    if(AG_MIN==aggs[i].op) v[i].d=(0==v[i].n||w[i].d<v[i].d?w[i].d:v[i].d);
+    else if(AG_MAX==aggs[i].op) v[i].d=(0==v[i].n||w[i].d>v[i].d?w[i].d:v[i].d);
+    else v[i].d+=w[i].d;
+    v[i].n+=w[i].n;
+  }
+}
+
+/* write the groups to the temporary files and forget them
+ */
+static void group_spill(struct groupby *gb)
+{
+  struct group *g;
+  FILE **f;
+  size_t i;
+
+  for(i=0;i<gb->ngrp;i++)
+  {
+    g=&gb->grp[i];
+    f=&gb->part[(g->hash>>32)%GROUPPARTS];
+    if(NULL==*f&&NULL==(*f=tmpfile())) err(1, "tmpfile");
+    if(1!=fwrite(&g->keylen,sizeof(size_t),1,*f)||g->keylen!=fwrite(g->key,1,g->keylen,*f)||(size_t)naggs!=fwrite(g->v,sizeof(struct aggval),naggs,*f)) err(1, "spill");
+  }
+  gb->spilled=1;
+  group_reset(gb);
+}
+
+/* aggregate the values of a row into its group
+ */
+static void group_row(struct cutrow *r)
+{
+  struct groupby *gb=r->cf->gb;
+  struct slice *v;
+  struct aggval *a;
+  struct group *g;
+  char num[64],*end;
+  double d;
+  int i;
+
+  r->keylen=0;
+  for(i=0;i<ngrpcols;i++)
+  {
+    v=&r->values[grpcols[i]];
+    memo_keyadd(r,(NULL==v->str?"":v->str),(NULL==v->str?0:v->len));
+  }
+  if(gb->mem>groupmem) group_spill(gb);
+  g=group_find(gb,r->key,r->keylen,group_hash(r->key,r->keylen));
+  for(i=0;i<naggs;i++)
+  {
+    a=&g->v[i];
+    if(AG_COUNT==aggs[i].op)
+    {
+      a->n++;
+      continue;
+    }
+    /* fields which are not a number are skipped */
+    v=&r->values[aggs[i].col];
+    if(NULL==v->str||0==v->len||v->len>=sizeof(num)) continue;
+    memcpy(num,v->str,v->len);
+    num[v->len]='\0';
+    d=strtod(num,&end);
+    if('\0'!=*end) continue;
+    if(AG_MIN==aggs[i].op) a->d=(0==a->n||d<a->d?d:a->d);
+    else if(AG_MAX==aggs[i].op) a->d=(0==a->n||d>a->d?d:a->d);
+    else a->d+=d;
+    a->n++;
+  }
+}
+
+/* print the groups found after the last spill, val has room for the aggregates
+ */
+static void group_print(struct cutrow *r, struct groupby *gb, char (*val)[32])
+{
+  struct group *g;
+  char const *k;
+  size_t i;
+  int j;
+
+  for(i=0;i<gb->ngrp;i++)
+  {
+    g=&gb->grp[i];
+    for(j=0,k=g->key;j<ngrpcols;j++)
+    {
+      r->values[j].str=k;
+      r->values[j].len=strlen(k);
+      k+=r->values[j].len+1;
+    }
+    for(j=0;j<naggs;j++)
+    {
+      if(AG_COUNT==aggs[j].op) snprintf(val[j],sizeof(val[j]),"%llu",(unsigned long long)g->v[j].n);
+      else if(AG_SUM==aggs[j].op) snprintf(val[j],sizeof(val[j]),"%.15g",g->v[j].d);
+      else if(0==g->v[j].n) val[j][0]='\0';
+      else snprintf(val[j],sizeof(val[j]),"%.15g",(AG_AVG==aggs[j].op?g->v[j].d/g->v[j].n:g->v[j].d));
+      r->values[ngrpcols+j].str=val[j];
+      r->values[ngrpcols+j].len=strlen(val[j]);
+    }
+    print_row(r,2);
+  }
+}
+
+/* print a row for each group in the output format, the key fields are followed by the aggregates
+   named like sum(column), the groups are in the order they were found unless they were spilled
+ */
+static void group_emit(struct cutfile *cf)
+{
+  static char const *const opname[]={"count","sum","min","max","avg"};
+  struct groupby *gb=cf->gb;
+  struct cutfile gf;
+  struct cutrow r;
+  struct aggval *v;
+  struct group *g;
+  char (*val)[32];
+  char *key;
+  size_t keylen,keysiz=0;
+  char const *name;
+  int i,n;
+
+  memset(&gf,0,sizeof(struct cutfile));
+  gf.dchar=cf->dchar;
+  gf.out=cf->out;
+  gf.prfld=cf->prfld;
+  gf.fldnum=n=ngrpcols+naggs;
+  gf.plan.nidx=gf.plan.nsplit=n;
+  if(NULL==(gf.fields=calloc(n,sizeof(char *)))||NULL==(gf.plan.keep=calloc(n,1))||NULL==(gf.plan.idx=calloc(n,sizeof(int)))) err(1, "calloc");
+  for(i=0;i<n;i++)
+  {
+    gf.plan.keep[i]=1;
+    gf.plan.idx[i]=i;
+    if(i<ngrpcols) name=(grpcols[i]<cf->fldnum&&NULL!=cf->fields[grpcols[i]]?cf->fields[grpcols[i]]:"");
+    else if(AG_COUNT==aggs[i-ngrpcols].op) name=NULL;
+    else name=(aggs[i-ngrpcols].col<cf->fldnum&&NULL!=cf->fields[aggs[i-ngrpcols].col]?cf->fields[aggs[i-ngrpcols].col]:"");
+    if(NULL==(gf.fields[i]=malloc((NULL==name?0:strlen(name))+8))) err(1, "malloc");
+    if(i<ngrpcols) strcpy(gf.fields[i],name);
+    else if(NULL==name) strcpy(gf.fields[i],opname[aggs[i-ngrpcols].op]);
+    else sprintf(gf.fields[i],"%s(%s)",opname[aggs[i-ngrpcols].op],name);
+    if(OT_XML==otype) xmltagsanitize(gf.fields[i]);
+  }
+  if(NULL==(val=calloc(naggs+1,sizeof(*val)))) err(1, "calloc");
+  cutrow_init(&r,&gf,cf->out);
+  if(OT_ARROW==otype) arrow_names(&gf);
+  else if(OT_JSON==otype||OT_NDJSON==otype) json_keys(&gf);
+  if(!Hflag)
+  {
+    for(i=0;i<n;i++)
+    {
+      r.values[i].str=gf.fields[i];
+      r.values[i].len=strlen(gf.fields[i]);
+    }
+    print_row(&r,1);
+  }
+  if(!gb->spilled) group_print(&r,gb,val);
+  else
+  {
+    /* each file has the partial aggregates of about 1/GROUPPARTS of the keys */
+    group_spill(gb);
+    if(NULL==(key=malloc(keysiz=FLDBUFSIZ))) err(1, "malloc");
+    if(NULL==(v=malloc((naggs+1)*sizeof(struct aggval)))) err(1, "malloc");
+    for(i=0;i<GROUPPARTS;i++)
+    {
+      if(NULL==gb->part[i]) continue;
+      rewind(gb->part[i]);
+      while(1==fread(&keylen,sizeof(size_t),1,gb->part[i]))
+      {
+        if(keylen>keysiz&&NULL==(key=realloc(key,keysiz=keylen))) err(1, "realloc");
+        if(keylen!=fread(key,1,keylen,gb->part[i])||(size_t)naggs!=fread(v,sizeof(struct aggval),naggs,gb->part[i])) errx(1, "truncated spill file");
+        g=group_find(gb,key,keylen,group_hash(key,keylen));
+        group_merge(g->v,v);
+      }
+      fclose(gb->part[i]);
+      gb->part[i]=NULL;
+      group_print(&r,gb,val);
+      group_reset(gb);
+    }
+    free(key);
+    free(v);
+  }
+  if(OT_ARROW==otype) arrow_batch(r.ab,cf->out);
+  cutrow_free(&r);
+  free(val);
+  if(NULL!=gf.jkeys)
+  {
+    free(gf.jkeys);
+    free(gf.jkeybuf);
+  }
+  for(i=0;i<n;i++) free(gf.fields[i]);
+  free(gf.fields);
+  plan_free(&gf.plan);
+}
+
+/* cut one record, the header row is line 1 and has to be cut first
+ */
+static void cut_row(struct cutrow *r, char *buf, size_t len, long lineno)
+{
+  struct plan *pl=&r->cf->plan;
+  int i,k;
+
+  arena_reset(r->arena);
+  if(!split_row(r,buf,len,lineno)) return;
+  for(k=0;k<pl->nco&&(lineno>1||!sflag);k++)
+  {
+    i=pl->cofld[k];
+    if(NULL!=r->values[i].str) run_callout(r,i,pl->coprcol[k],r->cf->fields[i],r->values);
+  }
+  callout_wait(r);
+  if(pl->nco>0) stats_stage(r,ST_CALLOUT);
+  print_row(r,lineno);
+  stats_stage(r,ST_FORMAT);
+}
+
+/* a row of the -P window waiting for its callouts
+ */
+struct prow
+{
+  struct slice *values;
+  struct slice *procval;
+  struct arena arena;  /* copies of the values, the record buffer is reused */
+  long lineno;
+  int *tcol;        /* input columns with a callout */
+  int *tprcol;      /* their output columns */
+  int ntask;
+  int next;         /* first task not started */
+  int running;
+  int seq;          /* tasks depend on each other and run one by one */
+};
+
+/* a callout command running in the -P pool
+ */
+struct job
+{
+  pid_t pid;
+  int fd;
+  struct prow *row;
+  int col;
+  struct callout *c;
+  char *out;        /* kept by the slot for the next commands */
+  size_t len,siz;
+  char *key;
+  size_t keylen;
+  uint64_t t0;      /* --stats, start of the command */
+};
+
+struct pool
+{
+  struct cutrow *r;
+  struct slice *values;    /* own arrays of the row scratch */
+  struct slice *procval;
+  struct prow *rows; /* ring of the buffered rows */
+  int nrows,head,cnt;
+  struct job *jobs;
+  struct pollfd *pfd;
+  int njobs;
+};
+
+static void pool_init(struct pool *pl, struct cutrow *r)
+{
+  int i,n=r->cf->fldnum;
+
+  memset(pl,0,sizeof(struct pool));
+  pl->r=r;
+  pl->values=r->values;
+  pl->procval=r->procval;
+  pl->nrows=4*pjobs;
+  pl->rows=calloc(pl->nrows,sizeof(struct prow));
+  pl->jobs=calloc(pjobs,sizeof(struct job));
+  pl->pfd=calloc(pjobs,sizeof(struct pollfd));
+  if(NULL==pl->rows||NULL==pl->jobs||NULL==pl->pfd) err(1, "calloc");
+  for(i=0;i<pl->nrows;i++)
+  {
+    pl->rows[i].values=calloc(n,sizeof(struct slice));
+    pl->rows[i].procval=calloc(n,sizeof(struct slice));
+    pl->rows[i].tcol=calloc(n,sizeof(int));
+    pl->rows[i].tprcol=calloc(n,sizeof(int));
+    if(NULL==pl->rows[i].values||NULL==pl->rows[i].procval||NULL==pl->rows[i].tcol||NULL==pl->rows[i].tprcol) err(1, "calloc");
+  }
+}
+
+static void pool_free(struct pool *pl)
+{
+  int i;
+
+  pl->r->values=pl->values;
+  pl->r->procval=pl->procval;
+  pl->r->arena=&pl->r->rowarena;
+  for(i=0;i<pjobs;i++) if(NULL!=pl->jobs[i].out) free(pl->jobs[i].out);
+  for(i=0;i<pl->nrows;i++)
+  {
+    arena_free(&pl->rows[i].arena);
+    free(pl->rows[i].values);
+    free(pl->rows[i].procval);
+    free(pl->rows[i].tcol);
+    free(pl->rows[i].tprcol);
+  }
+  free(pl->rows);
+  free(pl->jobs);
+  free(pl->pfd);
+  memset(pl,0,sizeof(struct pool));
+}
+
+/* start a task of a row, returns 0 if it is already done
+ */
+static int job_start(struct pool *pl, struct prow *row)
+{
+  struct cutrow *r=pl->r;
+  struct job *jb;
+  struct callout *c;
+  int fd[2],col,prcol,i;
+
+  col=row->tcol[row->next];
+  prcol=row->tprcol[row->next++];
+  r->values=row->values;
+  r->procval=row->procval;
+  r->arena=&row->arena;
+  if(NULL==(c=get_callout(col))) return(0);
+  if(CO_SHELL!=c->type)
+  {
+    run_callout(r,col,prcol,r->cf->fields[col],row->values);
+    callout_wait(r);
+    return(0);
+  }
+  value_str(r,&row->values[col]);
+  for(i=0;i<cb_pass_fld_max;i++) if(cb_pass_fld[i]!=0) value_str(r,&row->values[i]);
+  if(memomax>0)
+  {
+    memo_key(r,c,col,prcol,row->values);
+    row->procval[col]=row->values[col];
+    if(memo_get(r,r->key,r->keylen,&row->values[col]))
+    {
+      if(statsflag) __atomic_add_fetch(&c->hits,1,__ATOMIC_RELAXED);
+      return(0);
+    }
+  }
+  jb=&pl->jobs[pl->njobs];
+  jb->len=0;
+  jb->key=NULL;
+  if(statsflag) jb->t0=now_ns();
+  callout_cmdline(r,c,row->values[col].str,col,prcol,r->cf->fields[col],row->values);
+  if(0!=pipe(fd)) err(1, "pipe");
+  (void)fcntl(fd[0],F_SETFD,FD_CLOEXEC);
+  (void)fcntl(fd[1],F_SETFD,FD_CLOEXEC);
+  if(0>(jb->pid=fork()))
+  {
+    close(fd[0]);
+    close(fd[1]);
+    callout_disable(col,c,"Cannot open");
+    return(0);
+  }
+  if(0==jb->pid)
+  {
+    if(0>dup2(fd[1],STDOUT_FILENO)) _exit(127);
+    execl("/bin/sh","sh","-c",r->cmd,(char *)NULL);
+    _exit(127);
+  }
+  close(fd[1]);
+  jb->fd=fd[0];
+  jb->row=row;
+  jb->col=col;
+  jb->c=c;
+  if(memomax>0)
+  {
+    jb->key=arena_strndup(&row->arena,r->key,r->keylen);
+    jb->keylen=r->keylen;
+  }
+  row->running++;
+  pl->njobs++;
+  return(1);
+}
+
+static void job_finish(struct pool *pl, struct job *jb)
+{
+  struct prow *row=jb->row;
+  struct job tmp;
+  int st;
+
+  close(jb->fd);
+  while(0>waitpid(jb->pid,&st,0)&&EINTR==errno);
+  if(statsflag) stats_callout(jb->c,jb->t0);
+  if(0!=st) callout_disable(jb->col,jb->c,"Failed to call");
+  else
+  {
+    if(NULL!=jb->key) memo_put(jb->key,jb->keylen,(jb->len>0?jb->out:row->values[jb->col].str),(jb->len>0?jb->len:row->values[jb->col].len));
+    if(jb->len>0)
+    {
+      row->procval[jb->col]=row->values[jb->col];
+      row->values[jb->col].str=arena_strndup(&row->arena,jb->out,jb->len);
+      row->values[jb->col].len=jb->len;
+    }
+  }
+  row->running--;
+  /* swap with the last slot to keep the output buffers */
+  tmp=*jb;
+  *jb=pl->jobs[--pl->njobs];
+  pl->jobs[pl->njobs]=tmp;
+}
+
+/* start the tasks of the buffered rows in order as long as there are free slots
+ */
+static void pool_schedule(struct pool *pl)
+{
+  struct prow *row;
+  int i;
+
+  for(i=0;i<pl->cnt&&pl->njobs<pjobs;i++)
+  {
+    row=&pl->rows[(pl->head+i)%pl->nrows];
+    while(row->next<row->ntask&&pl->njobs<pjobs&&(!row->seq||0==row->running)) job_start(pl,row);
+  }
+}
+
+/* read the output of the running commands until at least one finishes
+ */
+static void pool_poll(struct pool *pl)
+{
+  struct job *jb;
+  ssize_t n;
+  int i,done;
+
+  for(done=0;!done&&pl->njobs>0;)
+  {
+    for(i=0;i<pl->njobs;i++)
+    {
+      pl->pfd[i].fd=pl->jobs[i].fd;
+      pl->pfd[i].events=POLLIN;
+    }
+    if(0>poll(pl->pfd,pl->njobs,-1))
+    {
+      if(EINTR==errno) continue;
+      err(1, "poll");
+    }
+    for(i=pl->njobs-1;i>=0;i--)
+    {
+      if(0==pl->pfd[i].revents) continue;
+      jb=&pl->jobs[i];
+      if(jb->len==jb->siz)
+      {
+        jb->siz=(0==jb->siz?FLDBUFSIZ:2*jb->siz);
+        stats_realloc();
+        if(NULL==(jb->out=realloc(jb->out,jb->siz))) err(1, "realloc");
       }
-      // get line
-      ccsv_init_ex(&c,buf,dchar);
-      for(i=col=0;NULL!=(f=ccsv_nextfield(&c,&typ));i++)
+      n=read(jb->fd,&jb->out[jb->len],jb->siz-jb->len);
+      if(n>0) jb->len+=n;
+      else if(0==n||EINTR!=errno)
       {
-        if(i>=fldnum) continue;
-        values[i]=NULL;
-        procval[i]=NULL;
-        if(1==lineno)
-        {
-          fields[i]=strdup(f);
-          if(NULL==fields[i]) err(1, "strdup");
-          if(OT_XML==otype) xmltagsanitize(fields[i]);
-        }
-        if(1==lineno&&Hflag) continue;
-        if(NULL==positions||(autostop>1&&autostop<(i+1))||(maxval>i&&positions[i+1]!=0))
-        {
-          if(NULL!=f) values[i]=strdup(f);
-          col++;
-        }
+        job_finish(pl,jb);
+        done=1;
+      }
+    }
+  }
+}
+
+/* print the finished rows at the head of the window
+ */
+static void pool_emit(struct pool *pl)
+{
+  struct prow *row;
+
+  stats_stage(pl->r,ST_CALLOUT);
+  while(pl->cnt>0)
+  {
+    row=&pl->rows[pl->head];
+    if(row->next<row->ntask||row->running>0) break;
+    pl->r->values=row->values;
+    pl->r->procval=row->procval;
+    pl->r->arena=&row->arena;
+    print_row(pl->r,row->lineno);
+    pl->head=(pl->head+1)%pl->nrows;
+    pl->cnt--;
+  }
+  stats_stage(pl->r,ST_FORMAT);
+}
+
+/* cut a record and run its callouts in the pool, rows are printed in input order
+ */
+static void pool_row(struct pool *pl, char *buf, size_t len, long lineno)
+{
+  struct cutrow *r=pl->r;
+  struct plan *plan=&r->cf->plan;
+  struct prow *row;
+  int i,k;
+
+  for(;;)
+  {
+    pool_schedule(pl);
+    pool_emit(pl);
+    if(pl->cnt<pl->nrows) break;
+    pool_poll(pl);
+  }
+  row=&pl->rows[(pl->head+pl->cnt++)%pl->nrows];
+  r->values=row->values;
+  r->procval=row->procval;
+  r->arena=&row->arena;
+  arena_reset(&row->arena);
+  if(!split_row(r,buf,len,lineno))
+  {
+    pl->cnt--;
+    return;
+  }
+  row->lineno=lineno;
+  row->ntask=row->next=row->running=row->seq=0;
+  for(k=0;k<plan->nidx;k++)
+  {
+    i=plan->idx[k];
+    if(NULL!=row->values[i].str) row->values[i].str=arena_strndup(&row->arena,row->values[i].str,row->values[i].len);
+  }
+  for(k=0;k<plan->nco;k++)
+  {
+    i=plan->cofld[k];
+    if(NULL==row->values[i].str||NULL==get_callout(i)) continue;
+    if(i<cb_pass_fld_max&&0!=cb_pass_fld[i]) row->seq=1;
+    row->tcol[row->ntask]=i;
+    row->tprcol[row->ntask++]=plan->coprcol[k];
+  }
+  if(row->ntask<2) row->seq=0;
+  pool_schedule(pl);
+  pool_emit(pl);
+}
+
+static void pool_drain(struct pool *pl)
+{
+  while(pl->cnt>0)
+  {
+    pool_schedule(pl);
+    pool_emit(pl);
+    if(pl->cnt>0) pool_poll(pl);
+  }
+}
+
+/* records of a byte range found by --count, the first and the last one may continue
+   in the ranges before and after it
+ */
+struct reccount
+{
+  uint64_t records;  /* newlines ending a record */
+  size_t headlen;    /* bytes before the first of them */
+  int headdlm;       /* and the delimiters in these bytes */
+  size_t taillen;    /* bytes after the last one */
+  int taildlm;
+  size_t maxlen;     /* longest record between them */
+  int maxflds;
+};
+
+/* one byte range of a mapped file cut by a worker thread
+ */
+struct chunk
+{
+  char *start;   /* first byte of the range */
+  char *rec;     /* first record starting in the range */
+  long lineno;   /* first cached row of the range */
+  int quotes;    /* parity of the quotes in the range */
+  int inq;       /* the range starts inside a quoted field */
+  struct reccount cnt; /* --count of the range */
+  int rows;      /* records cut */
+  struct outbuf out; /* formatted rows */
+  int done;
+};
+
+struct cutpar
+{
+  struct cutfile *cf;
+  struct chunk *ck;
+  char *end;
+  long endline;  /* end of the cached rows */
+  int nck;
+  int next;      /* next chunk to take */
+  int emitted;   /* chunks written to the output */
+  int window;    /* chunks allowed ahead of the output */
+  pthread_mutex_t mtx;
+  pthread_cond_t cond;
+};
+
+static void *count_worker(void *arg)
+{
+  struct cutpar *cp=arg;
+  int k;
+
+  for(;;)
+  {
+    pthread_mutex_lock(&cp->mtx);
+    k=cp->next++;
+    pthread_mutex_unlock(&cp->mtx);
+    if(k>=cp->nck) break;
+    cp->ck[k].quotes=csvcut_countquotes(cp->ck[k].start,(k+1<cp->nck?cp->ck[k+1].start:cp->end))&1;
+  }
+  return(NULL);
+}
+
+static void *cut_worker(void *arg)
+{
+  struct cutpar *cp=arg;
+  struct cutrow r;
+  struct csvin in;
+  struct chunk *ck;
+  char *buf;
+  size_t len;
+  long l;
+  int k;
+
+  cutrow_init(&r,cp->cf,NULL);
+  for(;;)
+  {
+    pthread_mutex_lock(&cp->mtx);
+    while(cp->next<cp->nck&&cp->next>=cp->emitted+cp->window) pthread_cond_wait(&cp->cond,&cp->mtx);
+    k=cp->next++;
+    pthread_mutex_unlock(&cp->mtx);
+    if(k>=cp->nck) break;
+    ck=&cp->ck[k];
+    outbuf_init(&ck->out,-1,OUTBUFSIZ);
+    r.out=&ck->out;
+    r.rows=0;
+    if(NULL!=r.st) r.tlast=now_ns();
+    if(NULL!=cp->cf->cc)
+    {
+      for(l=ck->lineno;l<(k+1<cp->nck?cp->ck[k+1].lineno:cp->endline);l++) cut_row(&r,NULL,0,l);
+    }
+    else
+    {
+      csvin_range(&in,ck->rec,(k+1<cp->nck?cp->ck[k+1].rec:cp->end));
+      while(NULL!=(buf=csvin_next(&in,&len)))
+      {
+        stats_stage(&r,ST_READ);
+        cut_row(&r,buf,len,2);
+      }
+      csvin_close(&in);
+    }
+    if(NULL!=r.ab) arrow_batch(r.ab,r.out);
+    ck->rows=r.rows;
+    pthread_mutex_lock(&cp->mtx);
+    ck->done=1;
+    pthread_cond_broadcast(&cp->cond);
+    pthread_mutex_unlock(&cp->mtx);
+  }
+  cutrow_free(&r);
+  return(NULL);
+}
+
+static void run_workers(struct cutpar *cp, void *(*fn)(void *))
+{
+  pthread_t *th;
+  int i,n;
+
+  n=(jobs<cp->nck?jobs:cp->nck);
+  if(NULL==(th=calloc(n,sizeof(pthread_t)))) err(1, "calloc");
+  for(i=0;i<n;i++) if(0!=(errno=pthread_create(&th[i],NULL,fn,cp))) err(1, "pthread_create");
+  if(fn==cut_worker)
+  {
+    int k,rows;
+    /* write the chunks in input order while the workers go ahead */
+    for(k=rows=0;k<cp->nck;k++)
+    {
+      pthread_mutex_lock(&cp->mtx);
+      while(!cp->ck[k].done) pthread_cond_wait(&cp->cond,&cp->mtx);
+      pthread_mutex_unlock(&cp->mtx);
+      if(rows>0&&cp->ck[k].rows>0) print_rowsep(cp->cf->out);
+      rows+=cp->ck[k].rows;
+      outbuf_write(cp->cf->out,cp->ck[k].out.buf,cp->ck[k].out.len);
+      if(uflag) outbuf_flush(cp->cf->out);
+      outbuf_free(&cp->ck[k].out);
+      pthread_mutex_lock(&cp->mtx);
+      cp->emitted++;
+      pthread_cond_broadcast(&cp->cond);
+      pthread_mutex_unlock(&cp->mtx);
+    }
+  }
+  for(i=0;i<n;i++) pthread_join(th[i],NULL);
+  free(th);
+}
+
+/* cut the cached rows from lineno to endline on several threads
+ */
+static void cut_parallel_cached(struct cutfile *cf, long lineno, long endline)
+{
+  struct cutpar cp;
+  long n,ckrows;
+  int k;
+
+  memset(&cp,0,sizeof(struct cutpar));
+  n=endline-lineno;
+  ckrows=n/jobs;
+  if(ckrows<CHUNKROWS/16) ckrows=CHUNKROWS/16;
+  if(ckrows>CHUNKROWS) ckrows=CHUNKROWS;
+  cp.cf=cf;
+  cp.endline=endline;
+  cp.nck=(n+ckrows-1)/ckrows;
+  cp.window=2*jobs;
+  if(NULL==(cp.ck=calloc(cp.nck,sizeof(struct chunk)))) err(1, "calloc");
+  for(k=0;k<cp.nck;k++) cp.ck[k].lineno=lineno+k*ckrows;
+  pthread_mutex_init(&cp.mtx,NULL);
+  pthread_cond_init(&cp.cond,NULL);
+  run_workers(&cp,cut_worker);
+  pthread_cond_destroy(&cp.cond);
+  pthread_mutex_destroy(&cp.mtx);
+  free(cp.ck);
+}
+
+/* cut the records of a mapped file after the header on several threads
+   the quote parity at the start of each range is known from a counting pass
+   so every range starts exactly at a record boundary, an index gives them directly
+ */
+static void cut_parallel(struct cutfile *cf, struct csvin *in, struct csvidx *ix)
+{
+  struct cutpar cp;
+  char *start=in->pos,*end=in->end;
+  size_t siz,cksiz,s;
+  char *p,*nl;
+  int k,q,n;
+
+  memset(&cp,0,sizeof(struct cutpar));
+  siz=end-start;
+  cksiz=siz/jobs;
+  if(cksiz<CHUNKMIN) cksiz=CHUNKMIN;
+  if(cksiz>CHUNKMAX) cksiz=CHUNKMAX;
+  cp.cf=cf;
+  cp.end=end;
+  cp.nck=(siz+cksiz-1)/cksiz;
+  cp.window=2*jobs;
+  if(NULL==(cp.ck=calloc(cp.nck+1,sizeof(struct chunk)))) err(1, "calloc");
+  pthread_mutex_init(&cp.mtx,NULL);
+  pthread_cond_init(&cp.cond,NULL);
+  if(NULL!=ix)
+  {
+    /* the record boundaries of the index are used without a counting pass */
+    cp.ck[0].rec=start;
+    for(cp.nck=1,s=0;s<ix->h.noffs;s++)
+    {
+      p=in->map+(ix->offs[s]-in->mapoff);
+      if(p>=end) break;
+      if(p>start&&(size_t)(p-cp.ck[cp.nck-1].rec)>=cksiz) cp.ck[cp.nck++].rec=p;
+    }
+  }
+  else
+  {
+    for(k=0;k<cp.nck;k++) cp.ck[k].start=start+k*cksiz;
+    run_workers(&cp,count_worker);
+  }
+  for(k=0,q=0;NULL==ix&&k<cp.nck;q^=cp.ck[k++].quotes)
+  {
+    p=cp.ck[k].start;
+    if(0==k||('\n'==p[-1]&&0==q))
+    {
+      cp.ck[k].rec=p;
+      continue;
+    }
+    n=q;
+    cp.ck[k].rec=(NULL==(nl=(char *)csvcut_recend(p,end,&n))?end:nl+1);
+  }
+  cp.next=0;
+  run_workers(&cp,cut_worker);
+  pthread_cond_destroy(&cp.cond);
+  pthread_mutex_destroy(&cp.mtx);
+  free(cp.ck);
+}
+
+/* bitmasks of the newlines, quotes and delimiters in 64 bytes
+   with the block scanner of ccsv picked at runtime, which finds a byte and the quotes
+ */
+static inline void count_masks(ccsv_maskfn fn, char const *p, char dchar, uint64_t *nl, uint64_t *q, uint64_t *d)
+{
+  *q=fn(p,'"');
+  *nl=fn(p,'\n')&~*q;
+  *d=fn(p,dchar)&~*q;
+}
+
+/* bit n is set if there is an odd number of bits up to n, the bytes inside quotes
+ */
+static inline uint64_t prefix_xor(uint64_t m)
+{
+  m^=m<<1;
+  m^=m<<2;
+  m^=m<<4;
+  m^=m<<8;
+  m^=m<<16;
+  m^=m<<32;
+  return(m);
+}
+
+/* count the records of a range 64 bytes at a time, newlines and delimiters count outside quotes
+   like in csvin_next() and csvcut_countfields(), inq is the quote parity at the start and the end
+ */
+static void count_range(char const *str, char const *end, char dchar, int *inq, struct reccount *rc)
+{
+  ccsv_maskfn fn=ccsv_maskfn_get();
+  char blk[64];
+  char const *p;
+  uint64_t nl,q,d,in,ends,below;
+  size_t off,rec=0,len;
+  int dlm=0,n,b;
+
+  memset(rc,0,sizeof(struct reccount));
+  for(p=str;p<end;p+=64)
+  {
+    if(end-p<64)
+    {
+      memset(blk,0,sizeof(blk));
+      memcpy(blk,p,end-p);
+      count_masks(fn,blk,dchar,&nl,&q,&d);
+    }
+    else count_masks(fn,p,dchar,&nl,&q,&d);
+    in=prefix_xor(q)^(*inq?~(uint64_t)0:0);
+    *inq=(int)(in>>63);
+    ends=nl&~in;
+    d&=~in;
+    off=p-str;
+    for(;0!=ends;ends&=ends-1)
+    {
+      b=__builtin_ctzll(ends);
+      below=((uint64_t)1<<b)-1;
+      n=dlm+__builtin_popcountll(d&below);
+      len=off+b-rec;
+      if(0==rc->records++)
+      {
+        rc->headlen=len;
+        rc->headdlm=n;
       }
-      if(1==lineno&&NULL!=reorder_fields&&OT_JSON==otype)
+      else
       {
-        char str[32];
-        for(col=0;0!=reorder_fields[col];col++);
-        out_fields=calloc(col+1,sizeof(char *));
-        for(i=0;0!=reorder_fields[i];i++)
-        {
-          snprintf(str,sizeof(str),"%d",i+1);
-          out_fields[i]=strdup(str);
-        }
+        if(len>rc->maxlen) rc->maxlen=len;
+        if(n+1>rc->maxflds) rc->maxflds=n+1;
+      }
+      d&=~below;
+      dlm=0;
+      rec=off+b+1;
+    }
+    dlm+=__builtin_popcountll(d);
+  }
+  rc->taillen=(end-str)-rec;
+  rc->taildlm=dlm;
+}
+
+/* records of the file so far, the last one is not terminated yet
+ */
+struct countfile
+{
+  uint64_t records;
+  size_t partlen;
+  int partdlm;
+  int hdrflds;
+  size_t maxlen;
+  int maxflds;
+};
+
+static void count_record(struct countfile *cn, size_t len, int flds)
+{
+  if(0==cn->records++) cn->hdrflds=flds;
+  if(len>cn->maxlen) cn->maxlen=len;
+  if(flds>cn->maxflds) cn->maxflds=flds;
+}
+
+/* add the counts of the next range
+ */
+static void count_merge(struct countfile *cn, struct reccount *rc)
+{
+  if(0==rc->records)
+  {
+    cn->partlen+=rc->taillen;
+    cn->partdlm+=rc->taildlm;
+    return;
+  }
+  count_record(cn,cn->partlen+rc->headlen,cn->partdlm+rc->headdlm+1);
+  if(rc->records>1)
+  {
+    cn->records+=rc->records-1;
+    if(rc->maxlen>cn->maxlen) cn->maxlen=rc->maxlen;
+    if(rc->maxflds>cn->maxflds) cn->maxflds=rc->maxflds;
+  }
+  cn->partlen=rc->taillen;
+  cn->partdlm=rc->taildlm;
+}
+
+static void *reccount_worker(void *arg)
+{
+  struct cutpar *cp=arg;
+  struct chunk *ck;
+  int k;
+
+  for(;;)
+  {
+    pthread_mutex_lock(&cp->mtx);
+    k=cp->next++;
+    pthread_mutex_unlock(&cp->mtx);
+    if(k>=cp->nck) break;
+    ck=&cp->ck[k];
+    count_range(ck->start,(k+1<cp->nck?cp->ck[k+1].start:cp->end),cp->cf->dchar,&ck->inq,&ck->cnt);
+  }
+  return(NULL);
+}
+
+/* count the records of a mapped file on several threads
+   the quote parity at the start of each range is known from a counting pass like for -j
+ */
+static void count_parallel(struct cutfile *cf, struct csvin *in, struct countfile *cn)
+{
+  struct cutpar cp;
+  size_t siz,cksiz;
+  int k,q;
+
+  memset(&cp,0,sizeof(struct cutpar));
+  siz=in->end-in->pos;
+  cksiz=siz/jobs;
+  if(cksiz<CHUNKMIN) cksiz=CHUNKMIN;
+  if(cksiz>CHUNKMAX) cksiz=CHUNKMAX;
+  cp.cf=cf;
+  cp.end=in->end;
+  cp.nck=(siz+cksiz-1)/cksiz;
+  if(NULL==(cp.ck=calloc(cp.nck+1,sizeof(struct chunk)))) err(1, "calloc");
+  pthread_mutex_init(&cp.mtx,NULL);
+  pthread_cond_init(&cp.cond,NULL);
+  for(k=0;k<cp.nck;k++) cp.ck[k].start=in->pos+k*cksiz;
+  run_workers(&cp,count_worker);
+  for(k=0,q=0;k<cp.nck;q^=cp.ck[k++].quotes) cp.ck[k].inq=q;
+  cp.next=0;
+  run_workers(&cp,reccount_worker);
+  for(k=0;k<cp.nck;k++) count_merge(cn,&cp.ck[k].cnt);
+  pthread_cond_destroy(&cp.cond);
+  pthread_mutex_destroy(&cp.mtx);
+  free(cp.ck);
+}
+
+static void names_setup(char const *fnam, char *hdr, size_t len, char dchar);
+
+/* --count, print the data rows, the fields of the header, the most fields and the longest record
+   of the file without splitting the records
+ */
+static int csv_count(FILE *fp, const char *fnam, char dchar, struct outbuf *out)
+{
+  struct csvin in;
+  struct cutfile cf;
+  struct countfile cn;
+  struct reccount rc;
+  char str[128];
+  int inq=0;
+
+  memset(&cf,0,sizeof(struct cutfile));
+  memset(&cn,0,sizeof(struct countfile));
+  cf.dchar=dchar;
+  csvin_open(&in,fp);
+  if(NULL!=in.map&&jobs>1&&in.pos<in.end) count_parallel(&cf,&in,&cn);
+  else
+  {
+    /* a stream is counted buffer by buffer, the buffer does not grow */
+    for(;;)
+    {
+      if(in.pos<in.end)
+      {
+        count_range(in.pos,in.end,dchar,&inq,&rc);
+        count_merge(&cn,&rc);
+        in.pos=in.end;
       }
-      for(i=col=0;i<fldnum;i++)
+      if(in.eof) break;
+      csvin_fill(&in);
+    }
+  }
+  if(cn.partlen>0) count_record(&cn,cn.partlen,cn.partdlm+1);
+  if(statsflag)
+  {
+    __atomic_add_fetch(&statsfiles,1,__ATOMIC_RELAXED);
+    __atomic_add_fetch(&statsbytes,(NULL!=in.map?(uint64_t)(in.end-in.pos):in.nread),__ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats.records,cn.records,__ATOMIC_RELAXED);
+  }
+  snprintf(str,sizeof(str),"%lu %d %d %zu ",(unsigned long)(cn.records>0?cn.records-1:0),cn.hdrflds,cn.maxflds,cn.maxlen);
+  outbuf_puts(out,str);
+  outbuf_puts(out,fnam);
+  outbuf_putc(out,'\n');
+  if(out==&stdoutbuf) outbuf_flush(out);
+  csvin_close(&in);
+
+  return(0);
+}
+
+static int csv_cut(FILE *fp, const char *fnam, char dchar, struct outbuf *out)
+{
+  struct csvin in;
+  struct cutfile cf;
+  struct cutrow r;
+  struct pool pl;
+  struct csvidx ix;
+  struct csvidx *ixp=NULL;
+  struct colcache cc;
+  char *buf;
+  size_t len;
+  long lineno=0,endline;
+  int i;
+
+  if(countflag) return(csv_count(fp,fnam,dchar,out));
+  memset(&pl,0,sizeof(struct pool));
+  memset(&cf,0,sizeof(struct cutfile));
+  memset(&r,0,sizeof(struct cutrow));
+  cf.dchar=dchar;
+  cf.out=out;
+  csvin_open(&in,fp);
+  if(statsflag)
+  {
+    __atomic_add_fetch(&statsfiles,1,__ATOMIC_RELAXED);
+    if(NULL!=in.map) __atomic_add_fetch(&statsbytes,in.end-in.pos,__ATOMIC_RELAXED);
+  }
+  cf.prfld=print_field_csv;
+  if(OT_JSON==otype)
+  {
+    cf.prfld=print_field_json;
+    outbuf_putc(out,'[');
+  }
+  else if(OT_NDJSON==otype) cf.prfld=print_field_json;
+  else if(OT_XML==otype)
+  {
+    cf.prfld=print_field_xml;
+    outbuf_write(out,"<xml>",5);
+  }
+  else if(OT_ARROW==otype) cf.prfld=print_field_arrow;
+  while(NULL!=(buf=csvin_next(&in,&len)))
+  {
+    stats_stage(&r,ST_READ);
+    lineno++;
+    if(lineno==1)
+    {
+      if(nnamedopts>0) names_setup(fnam,buf,len,dchar);
+      cf.fldnum=csvcut_countfields(buf,len,dchar);
+      if(NULL==(cf.fields=calloc(cf.fldnum,sizeof(char *)))) err(1, "calloc");
+      plan_compile(&cf);
+      if(gflag) group_init(&cf);
+      cutrow_init(&r,&cf,out);
+      cut_row(&r,buf,len,lineno);
+      if(OT_ARROW==otype&&NULL==cf.gb) arrow_names(&cf);
+      else if(OT_JSON==otype||OT_NDJSON==otype) json_keys(&cf);
+      if(NULL!=in.map&&fp!=stdin&&cache_load(&cc,&in,fnam,dchar,buf,len))
       {
-        if(NULL!=values[i])
+        /* the cached rows are numbered like the records, the mapped file is not read further */
+        cf.cc=&cc;
+        lineno=(rowsfrom>0?rowsfrom+1:2);
+        endline=(rowsto>0&&rowsto<(long)cc.h->rows?rowsto:(long)cc.h->rows)+2;
+        if(jobs>1)
         {
-          if(lineno>1||!sflag)
-          {
-            if(NULL!=(f=check_callout(values[i],i,col,fields[i],values,fldnum)))
-            {
-              procval[i]=values[i];
-              values[i]=strdup(f);
-            }
-          }
-          if(NULL==reorder_fields) prfld(values[i],i,col,fields[i]);
-          col++;
+          if(lineno<endline) cut_parallel_cached(&cf,lineno,endline);
+          break;
+        }
+        if(pjobs>0&&NULL!=cb) pool_init(&pl,&r);
+        for(;lineno<endline;lineno++)
+        {
+          if(NULL!=pl.r) pool_row(&pl,NULL,0,lineno);
+          else cut_row(&r,NULL,0,lineno);
         }
+        break;
       }
-      if(NULL!=reorder_fields&&(lineno>1||!Hflag))
+      if(NULL!=in.map&&(rowsfrom>0||jobs>1)&&fp!=stdin&&index_load(&ix,&in,fnam,buf,len)) ixp=&ix;
+      if(NULL!=in.map&&rowsfrom>0)
       {
-        int j,cmbn;
-        for(i=0,col=cmbn=0;0!=reorder_fields[i];i++,col++)
-        {
-          if(reorder_fields[i]==INF) prfld("",0,col,(OT_JSON==otype?out_fields[col]:""));
-          if(reorder_fields[i]<=COMBINES_MAX)
-          {
-            if(cmbn<((fldnum*2)-1))
-            {
-              cmbn_flds[cmbn++]=reorder_fields[i+1]-1;
-              cmbn_type=reorder_fields[i];
-            }
-            else err(1, "combine");
-            ++i;
-            --col;
-            continue;
-          }
-          if(abs(reorder_fields[i])>fldnum) continue;
-          if(0==cmbn)
-          {
-            if(reorder_fields[i]>0) prfld(values[reorder_fields[i]-1],reorder_fields[i]-1,col,(OT_JSON==otype?out_fields[col]:fields[reorder_fields[i]-1]));
-            else for(j=-reorder_fields[i];j<=fldnum;j++,col++) prfld(values[j-1],j-1,col,(OT_JSON==otype?out_fields[col]:fields[j-1]));
-          }
-          else
-          {
-            cmbn_flds[cmbn++]=reorder_fields[i]-1;
-            if(COMBINE_LONGER==cmbn_type)
-            {
-              int maxj=cmbn_flds[0],maxl=-1,l;
-              for(j=0;j<cmbn;j++)
-              {
-                l=strlen(values[cmbn_flds[j]]);
-                if(l>maxl)
-                { 
-                  maxj=cmbn_flds[j];
-                  maxl=l;
-                }
-              }
-              prfld(values[maxj],maxj,col,(OT_JSON==otype?out_fields[col]:fields[maxj]));
-            }
-            else if(COMBINE_UNION==cmbn_type)
-            {
-              int len=0;
-              char *cmb;
-              for(j=0;j<cmbn;j++) len+=strlen(values[cmbn_flds[j]]);
-              cmb=malloc(len+1);
-              if(NULL==cmb) err(1, "malloc");
-              cmb[0]='\0';
-              for(j=0;j<cmbn;j++) strcat(cmb,values[cmbn_flds[j]]);
-              prfld(cmb,cmbn_flds[0],col,(OT_JSON==otype?out_fields[col]:fields[cmbn_flds[0]]));
-              free(cmb);
-            }
-            else errx(1, "cmbn_type=%d cmbn=%d",cmbn_type,cmbn);
-            cmbn=0;
-          }
-        }
+        /* only the selected rows are left in the mapping */
+        buf=index_row(&in,ixp,in.pos,1,rowsfrom);
+        if(rowsto>0) in.end=index_row(&in,ixp,buf,rowsfrom,rowsto+1);
+        in.pos=buf;
       }
-      for(i=0;i<fldnum;i++)
+      if(jobs>1&&NULL!=in.map&&in.pos<in.end)
       {
-        if(NULL!=values[i]) free(values[i]);
-        if(NULL!=procval[i]) free(procval[i]);
-        values[i]=NULL;
-        procval[i]=NULL;
+        cut_parallel(&cf,&in,ixp);
+        break;
       }
-      if(OT_JSON==otype&&lineno>1) printf("}");
-      if(!((Hflag&&lineno==1)||OT_JSON==otype)) printf("\n");
+      if(pjobs>0&&NULL!=cb) pool_init(&pl,&r);
+      continue;
+    }
+    if(NULL==in.map&&rowsfrom>0)
+    {
+      if(lineno-1<rowsfrom) continue;
+      if(rowsto>0&&lineno-1>rowsto) break;
     }
+    if(NULL!=pl.r) pool_row(&pl,buf,len,lineno);
+    else cut_row(&r,buf,len,lineno);
   }
-  if(OT_JSON==otype) printf("]");
-  else if(OT_XML==otype) printf("</row></xml>");
-  if(NULL!=values)
+  if(NULL!=pl.r)
   {
-    free(values);
-    values=NULL;
+    pool_drain(&pl);
+    pool_free(&pl);
   }
-  if(NULL!=procval)
+  if(NULL!=cf.gb)
   {
-    free(procval);
-    procval=NULL;
+    group_emit(&cf);
+    group_free(cf.gb);
   }
-  if(NULL!=out_fields)
+  if(OT_JSON==otype) outbuf_putc(out,']');
+  else if(OT_XML==otype) outbuf_write(out,"</row></xml>",12);
+  else if(OT_ARROW==otype&&lineno>0)
   {
-    for(i=0;NULL!=out_fields[i];i++) free(out_fields[i]);
-    free(out_fields);
+    arrow_batch(r.ab,out);
+    arrow_eos(out);
   }
-  if(NULL!=fields)
+  if(out==&stdoutbuf) outbuf_flush(out);
+  if(NULL!=cf.out_fields)
   {
-    for(i=0;i<fldnum;i++) if(NULL!=fields[i]) free(fields[i]);
-    free(fields);
-    fields=NULL;
+    for(i=0;NULL!=cf.out_fields[i];i++) free(cf.out_fields[i]);
+    free(cf.out_fields);
   }
-  if(NULL!=cmbn_flds)
+  if(NULL!=cf.jkeys)
   {
-    free(cmbn_flds);
-    cmbn_flds=NULL;
+    free(cf.jkeys);
+    free(cf.jkeybuf);
   }
-  free(buf);
-  escape(NULL);
-  if(NULL!=positions) free(positions);
-  positions=NULL;
-  check_callout(NULL,0,0,NULL,NULL,0);
+  if(NULL!=cf.fields)
+  {
+    for(i=0;i<cf.fldnum;i++) if(NULL!=cf.fields[i]) free(cf.fields[i]);
+    free(cf.fields);
+  }
+  plan_free(&cf.plan);
+  cutrow_free(&r);
+  if(NULL!=ixp) free(ix.offs);
+  if(NULL!=cf.cc) cache_free(cf.cc);
+  if(statsflag) __atomic_add_fetch(&statsbytes,in.nread,__ATOMIC_RELAXED);
+  csvin_close(&in);
 
   return(0);
 }
 
+/* one file argument of -J, the output is spooled to a temporary file when the buffer is full
+ */
+struct shard
+{
+  char const *fnam;
+  FILE *spool;
+  struct outbuf out;
+  int errnum;    /* errno of opening the file */
+  int done;
+};
+
+struct cutfiles
+{
+  struct shard *sh;
+  int n;
+  char dchar;
+  int next;      /* next file to take */
+  int emitted;   /* files written to the output */
+  int window;    /* files allowed ahead of the output */
+  pthread_mutex_t mtx;
+  pthread_cond_t cond;
+};
+
+static void *file_worker(void *arg)
+{
+  struct cutfiles *cs=arg;
+  struct shard *sh;
+  FILE *fp;
+  int k;
+
+  for(;;)
+  {
+    pthread_mutex_lock(&cs->mtx);
+    while(cs->next<cs->n&&cs->next>=cs->emitted+cs->window) pthread_cond_wait(&cs->cond,&cs->mtx);
+    k=cs->next++;
+    pthread_mutex_unlock(&cs->mtx);
+    if(k>=cs->n) break;
+    sh=&cs->sh[k];
+    fp=stdin;
+    if(0!=strcmp(sh->fnam,"-")&&NULL==(fp=fopen(sh->fnam,"r"))) sh->errnum=errno;
+    if(NULL!=fp)
+    {
+      if(NULL==(sh->spool=tmpfile())) err(1, "tmpfile");
+      outbuf_init(&sh->out,fileno(sh->spool),(outbufsiz>SPOOLSIZ?outbufsiz:SPOOLSIZ));
+      csv_cut(fp,(fp==stdin?"stdin":sh->fnam),cs->dchar,&sh->out);
+      if(fp!=stdin) (void)fclose(fp);
+    }
+    pthread_mutex_lock(&cs->mtx);
+    sh->done=1;
+    pthread_cond_broadcast(&cs->cond);
+    pthread_mutex_unlock(&cs->mtx);
+  }
+  return(NULL);
+}
+
+/* look up the column names in the header row of the first file and check the header rows
+   of the others before the threads start, so neither the names nor the errors depend on
+   which file a thread reads first
+   returns 0 if the first file is stdin, its header row is only read when it is cut
+ */
+static int names_first(char **argv, int n, char dchar)
+{
+  struct csvin in;
+  FILE *fp;
+  char *hdr;
+  size_t len;
+  int k;
+
+  for(k=0;k<n;k++)
+  {
+    if(0==strcmp(argv[k],"-"))
+    {
+      if(!namesdone) return(0);
+      continue;
+    }
+    /* a file that cannot be opened is reported when it is cut */
+    if(NULL==(fp=fopen(argv[k],"r"))) continue;
+    csvin_open(&in,fp);
+    if(NULL!=(hdr=csvin_next(&in,&len))) names_setup(argv[k],hdr,len,dchar);
+    csvin_close(&in);
+    (void)fclose(fp);
+  }
+  return(1);
+}
+
+/* cut the file arguments on fjobs threads and write their output in argument order
+ */
+static int cut_files(char **argv, int n, char dchar)
+{
+  struct cutfiles cs;
+  struct shard *sh;
+  pthread_t *th;
+  int i,k,nth,rval=0;
+
+  memset(&cs,0,sizeof(struct cutfiles));
+  cs.n=n;
+  cs.dchar=dchar;
+  cs.window=2*fjobs;
+  nth=(fjobs<n?fjobs:n);
+  /* names in the header of stdin, the files are cut one after the other */
+  if(nnamedopts>0&&!names_first(argv,n,dchar)) nth=1;
+  if(NULL==(cs.sh=calloc(n,sizeof(struct shard)))) err(1, "calloc");
+  if(NULL==(th=calloc(nth,sizeof(pthread_t)))) err(1, "calloc");
+  for(k=0;k<n;k++) cs.sh[k].fnam=argv[k];
+  pthread_mutex_init(&cs.mtx,NULL);
+  pthread_cond_init(&cs.cond,NULL);
+  for(i=0;i<nth;i++) if(0!=(errno=pthread_create(&th[i],NULL,file_worker,&cs))) err(1, "pthread_create");
+  for(k=0;k<n;k++)
+  {
+    sh=&cs.sh[k];
+    pthread_mutex_lock(&cs.mtx);
+    while(!sh->done) pthread_cond_wait(&cs.cond,&cs.mtx);
+    pthread_mutex_unlock(&cs.mtx);
+    if(0!=sh->errnum)
+    {
+      errno=sh->errnum;
+      warn("%s",sh->fnam);
+      rval=1;
+    }
+    else
+    {
+      outbuf_copy(&stdoutbuf,fileno(sh->spool));
+      outbuf_write(&stdoutbuf,sh->out.buf,sh->out.len);
+      outbuf_flush(&stdoutbuf);
+      outbuf_free(&sh->out);
+      (void)fclose(sh->spool);
+    }
+    pthread_mutex_lock(&cs.mtx);
+    cs.emitted++;
+    pthread_cond_broadcast(&cs.cond);
+    pthread_mutex_unlock(&cs.mtx);
+  }
+  for(i=0;i<nth;i++) pthread_join(th[i],NULL);
+  pthread_cond_destroy(&cs.cond);
+  pthread_mutex_destroy(&cs.mtx);
+  free(th);
+  free(cs.sh);
+  return(rval);
+}
+
 static void usage(char *argv0, int st)
 {
-  (void)fprintf(stderr, "usage: %s [-f list|-r list] [-H] [-s] [-q] [-o csv|json|xml] [-d delim] [-D output-delim] [-c field/args:cmd] [file ...]\n", argv0);
+  (void)fprintf(stderr, "usage: %s [-f list|-r list] [-H] [-s] [-q] [-o csv|json|ndjson|xml|arrow] [-d delim] [-D output-delim] [-c field/args:cmd] [-m cache-size] [-P callouts] [-j jobs] [-J files] [-B bufsize] [-u] [-w filter] [--rows from-to] [--index[=step]] [--cache] [--batch rows] [--stats] [--count] [-g fields] [-a aggregates] [--group-mem bytes] [file ...]\n", argv0);
   exit(st);
 }
 
@@ -641,22 +4635,136 @@ static char *parse_range(char *s, char *d, int *min, int *max)
   return(ret);
 }
 
+/* the argument of a transform up to the closing ')', which is kept in spec
+   a backslash escapes the next character, so the argument may contain ')' like in "@suffix(\))"
+ */
+static char *xform_arg(char **spec, char const *name)
+{
+  char *p=*spec,*arg,*a;
+
+  if(NULL==(a=arg=malloc(strlen(p)+1))) err(1, "malloc");
+  for(;')'!=*p;p++)
+  {
+    if('\\'==*p&&'\0'!=p[1]) p++;
+    else if('\0'==*p) errx(1, "missing ')' of '@%s'",name);
+    *a++=*p;
+  }
+  *a='\0';
+  *spec=p;
+  return(arg);
+}
+
+/* compile a chain of built-in transforms like "@trim@substr(0,3)@upper"
+ */
+static void xform_compile(struct callout *c, char *spec)
+{
+  static struct { char const *name; enum xfop op; int args; } const ops[]=
+  {
+    {"upper",XF_UPPER,0},
+    {"lower",XF_LOWER,0},
+    {"trim",XF_TRIM,0},
+    {"substr",XF_SUBSTR,1},
+    {"prefix",XF_PREFIX,1},
+    {"suffix",XF_SUFFIX,1},
+    {"replace",XF_REPLACE,1},
+    {"join",XF_JOIN,1},
+  };
+  struct xform *x;
+  char *p,*q,d;
+  size_t n,i;
+
+  while('@'==*spec)
+  {
+    n=strcspn(++spec,"(@");
+    for(i=0;i<sizeof(ops)/sizeof(ops[0]);i++) if(strlen(ops[i].name)==n&&0==strncmp(spec,ops[i].name,n)) break;
+    if(i==sizeof(ops)/sizeof(ops[0])) errx(1, "unknown transform '@%.*s'",(int)n,spec);
+    if(NULL==(c->xf=realloc(c->xf,(c->nxf+1)*sizeof(struct xform)))) err(1, "realloc");
+    x=&c->xf[c->nxf++];
+    memset(x,0,sizeof(struct xform));
+    x->op=ops[i].op;
+    x->b=-1;
+    spec+=n;
+    if(!ops[i].args) continue;
+    if('('!=*spec++) errx(1, "missing arguments of '@%s'",ops[i].name);
+    switch(x->op)
+    {
+      case XF_SUBSTR:
+        x->a=strtol(spec,&spec,10);
+        if(','==*spec&&0>(x->b=strtol(spec+1,&spec,10))) errx(1, "negative length of '@substr'");
+        break;
+      case XF_REPLACE:
+        /* any delimiter: @replace(/a/b/) or @replace(|a|b|) */
+        if('\0'==(d=*spec++)||NULL==(p=strchr(spec,d))||NULL==(q=strchr(p+1,d))||p==spec) errx(1, "malformed arguments of '@replace'");
+        if(NULL==(x->s1=strndup(spec,p-spec))||NULL==(x->s2=strndup(p+1,q-p-1))) err(1, "strndup");
+        x->l2=q-p-1;
+        spec=q+1;
+        break;
+      default:
+        x->s1=xform_arg(&spec,ops[i].name);
+        break;
+    }
+    if(NULL!=x->s1) x->l1=strlen(x->s1);
+    if(')'!=*spec++) errx(1, "malformed arguments of '@%s'",ops[i].name);
+    if('@'!=*spec&&'\0'!=*spec) errx(1, "trailing characters after the arguments of '@%s': '%s'",ops[i].name,spec);
+  }
+  if('\0'!=*spec) errx(1, "malformed transform near '%s'",spec);
+}
+
+/* load "path:function" once, the hooks are looked up as function_init and function_finish
+ */
+static void plugin_load(struct callout *c, char *spec)
+{
+  csvcut_plugin_init_fn init;
+  char *path,*fn,*hook;
+
+  if(NULL==(fn=strrchr(spec,':'))||fn==spec||'\0'==fn[1]) errx(1, "plugin should be path:function '%s'",spec);
+  if(NULL==(path=strndup(spec,fn-spec))) err(1, "strndup");
+  fn++;
+  if(NULL==(c->dl=dlopen(path,RTLD_NOW|RTLD_LOCAL))) errx(1, "%s",dlerror());
+  free(path);
+  if(NULL==(c->fn=(csvcut_plugin_fn)dlsym(c->dl,fn))) errx(1, "%s",dlerror());
+  if(NULL==(hook=malloc(strlen(fn)+sizeof(CSVCUT_PLUGIN_FINISH)))) err(1, "malloc");
+  sprintf(hook,"%s" CSVCUT_PLUGIN_FINISH,fn);
+  c->finish=(csvcut_plugin_finish_fn)dlsym(c->dl,hook);
+  sprintf(hook,"%s" CSVCUT_PLUGIN_INIT,fn);
+  init=(csvcut_plugin_init_fn)dlsym(c->dl,hook);
+  if(NULL!=init&&0!=init(&c->state)) errx(1, "%s failed",hook);
+  free(hook);
+}
+
 static void setup_callout(char *arg)
 {
   // "2-3/1-2,4:./procfield23.sh"
+  struct callout *c;
   char *cmd;
   int min,max,i,rmn,rmx;
-  char *delim;
   
   if(NULL==arg)
   {
     if(NULL!=cb)
     {
-      for(i=0;i<cbsize;i++) if(NULL!=cb[i]) free(cb[i]);
       free(cb);
       cb=NULL;
       cbsize=0;
     }
+    while(NULL!=(c=callouts))
+    {
+      callouts=c->next;
+      for(i=0;i<c->nxf;i++)
+      {
+        if(NULL!=c->xf[i].s1) free(c->xf[i].s1);
+        if(NULL!=c->xf[i].s2) free(c->xf[i].s2);
+      }
+      if(NULL!=c->xf) free(c->xf);
+      if(NULL!=c->dl)
+      {
+        if(NULL!=c->finish) c->finish(c->state);
+        dlclose(c->dl);
+      }
+      free(c->cmd);
+      free(c);
+    }
+    ncallouts=0;
     return;
   }
   cmd=parse_range(arg,":/",&min,&max);
@@ -681,18 +4789,43 @@ static void setup_callout(char *arg)
   {
     if(cb==NULL)
     {
-      cb=calloc(max,sizeof(char *));
+      cb=calloc(max,sizeof(struct callout *));
+      if(NULL==cb) err(1, "calloc");
       cbsize=max;
     }
     else
     {
-      cb=realloc(cb,sizeof(char *)*max);
+      cb=realloc(cb,sizeof(struct callout *)*max);
       if(NULL==cb) err(1, "realloc");
       for(i=cbsize;i<max;i++) cb[i]=NULL;
       cbsize=max;
     }
   }
-  for(i=min;i<max;i++) if(NULL==(cb[i]=strdup(cmd))) err(1, "malloc");
+  if(NULL==(c=calloc(1,sizeof(struct callout)))) err(1, "calloc");
+  c->type=CO_SHELL;
+  if(0==strncmp(cmd,"coproc:",7))
+  {
+    c->type=CO_COPROC;
+    cmd+=7;
+  }
+  else if('@'==*cmd)
+  {
+    c->type=CO_BUILTIN;
+    xform_compile(c,cmd);
+  }
+  else if(0==strncmp(cmd,"plugin:",7))
+  {
+    c->type=CO_PLUGIN;
+    cmd+=7;
+    plugin_load(c,cmd);
+  }
+  if(NULL==(c->cmd=strdup(cmd))) err(1, "strdup");
+  c->id=ncallouts++;
+  c->fmin=min;
+  c->fmax=max;
+  c->next=callouts;
+  callouts=c;
+  for(i=min;i<max;i++) cb[i]=c;
 }
 
 static int *parse_rangeset(char *arg)
@@ -749,20 +4882,430 @@ static int *parse_rangeset(char *arg)
   return(ret);
 }
 
+/* header row indexed by a hash table of the names, the first of equal names is found
+ */
+struct hdrnames
+{
+  struct ccsv_field *flds;
+  int n;
+  int *tab;        /* field index + 1, 0 is empty */
+  size_t mask;
+};
+
+static int names_find(struct hdrnames *h, char const *str, size_t len)
+{
+  size_t k;
+  int i;
+
+  for(k=memo_hash(str,len)&h->mask;0!=(i=h->tab[k]);k=(k+1)&h->mask)
+  {
+    if(h->flds[i-1].len==len&&0==memcmp(h->flds[i-1].str,str,len)) return(i-1);
+  }
+  return(-1);
+}
+
+/* column number of a name, surrounding blanks are tried with and without, -1 if it is not a name
+ */
+static int names_col(struct hdrnames *h, char const *str, size_t len)
+{
+  int i;
+
+  if(0==len) return(-1);
+  if(0>(i=names_find(h,str,len)))
+  {
+    for(;len>0&&(' '==*str||'\t'==*str);str++,len--);
+    for(;len>0&&(' '==str[len-1]||'\t'==str[len-1]);len--);
+    if(len>0) i=names_find(h,str,len);
+  }
+  return(i);
+}
+
+/* write the number of a column named in a list and remember its name
+ */
+static void names_put(struct hdrnames *h, struct outbuf *o, int i)
+{
+  char num[32];
+
+  if(NULL==(colnames=realloc(colnames,(ncolnames+1)*sizeof(struct colname)))) err(1, "realloc");
+  colnames[ncolnames].col=i;
+  if(NULL==(colnames[ncolnames++].name=strndup(h->flds[i].str,h->flds[i].len))) err(1, "strndup");
+  snprintf(num,sizeof(num),"%d",i+1);
+  outbuf_puts(o,num);
+}
+
+/* the part of a list before the first of ends, split at the separators, has a name in it
+ */
+static int names_in(char const *list, char const *seps, char const *ends)
+{
+  size_t n;
+
+  for(;;)
+  {
+    n=strcspn(list,seps);
+    if(n>strcspn(list,ends)) n=strcspn(list,ends);
+    if(strspn(list,"0123456789- \t")<n) return(1);
+    list+=n;
+    if('\0'==*list||NULL!=strchr(ends,*list)) return(0);
+    list++;
+  }
+}
+
+/* replace the names of a list with their column numbers, also in "name-name" ranges
+   with words a part that is not a name may be blank separated words like in the lists of -f
+ */
+static char *names_subst(struct hdrnames *h, char const *list, char const *seps, char const *ends, int words)
+{
+  struct outbuf o;
+  char const *p;
+  char *part,*sub;
+  size_t n;
+  int i,j;
+
+  outbuf_init(&o,-1,strlen(list)+1);
+  for(;;)
+  {
+    n=strcspn(list,seps);
+    if(n>strcspn(list,ends)) n=strcspn(list,ends);
+    if(strspn(list,"0123456789- \t")>=n) outbuf_write(&o,list,n);
+    else if(0<=(i=names_col(h,list,n))) names_put(h,&o,i);
+    else
+    {
+      /* a range with a name at one or both ends */
+      for(p=list;NULL!=(p=memchr(p,'-',list+n-p));p++)
+      {
+        i=(p==list?-2:(strspn(list,"0123456789")==(size_t)(p-list)?-3:names_col(h,list,p-list)));
+        j=(p+1==list+n?-2:(strspn(p+1,"0123456789")==(size_t)(list+n-p-1)?-3:names_col(h,p+1,list+n-p-1)));
+        if(-1!=i&&-1!=j) break;
+      }
+      if(NULL==p&&words&&n>strcspn(list," \t"))
+      {
+        if(NULL==(part=strndup(list,n))) err(1, "strndup");
+        sub=names_subst(h,part," \t","",0);
+        outbuf_puts(&o,sub);
+        free(sub);
+        free(part);
+      }
+      else
+      {
+        if(NULL==p) errx(1, "no column named '%.*s'",(int)n,list);
+        /* -2 is an open end, -3 a number */
+        if(-3==i) outbuf_write(&o,list,p-list);
+        else if(i>=0) names_put(h,&o,i);
+        outbuf_putc(&o,'-');
+        if(-3==j) outbuf_write(&o,p+1,list+n-p-1);
+        else if(j>=0) names_put(h,&o,j);
+      }
+    }
+    list+=n;
+    if('\0'==*list||NULL!=strchr(ends,*list)) break;
+    outbuf_putc(&o,*list++);
+  }
+  outbuf_puts(&o,list);
+  outbuf_putc(&o,'\0');
+  return(o.buf);
+}
+
+/* keep an option with column names for the first header row, parse it now otherwise
+ */
+static void names_opt(int opt, char *arg)
+{
+  /* the fields of -g and -a are checked when the header is read */
+  if('g'==opt||'a'==opt||('c'==opt?names_in(arg,"/,",":"):names_in(arg,('f'==opt?",":",+^*"),"")))
+  {
+    if(NULL==(namedopts=realloc(namedopts,(nnamedopts+1)*sizeof(struct namedopt)))) err(1, "realloc");
+    namedopts[nnamedopts].opt=opt;
+    namedopts[nnamedopts++].arg=arg;
+  }
+  else if('f'==opt) get_list(arg);
+  else if('r'==opt) reorder_fields=parse_rangeset(arg);
+  else setup_callout(arg);
+}
+
+/* -g list of key fields
+ */
+static void setup_group(char *list)
+{
+  char *p;
+  int min,max;
+
+  while(NULL!=(p=strsep(&list,",")))
+  {
+    if(NULL==parse_range(p,"",&min,&max)||0==min||INF==max) errx(1, "bad -g field '%s'",p);
+    if(NULL==(grpcols=realloc(grpcols,(ngrpcols+max-min+1)*sizeof(int)))) err(1, "realloc");
+    while(min<=max) grpcols[ngrpcols++]=min++-1;
+  }
+}
+
+/* -a list of aggregates: count, sum:N, min:N, max:N and avg:N
+ */
+static void setup_aggs(char *list)
+{
+  static struct { char const *name; enum aggop op; } const ops[]=
+  {
+    {"count",AG_COUNT}, {"sum",AG_SUM}, {"min",AG_MIN}, {"max",AG_MAX}, {"avg",AG_AVG},
+  };
+  char *p,*col,*end;
+  size_t i;
+
+  while(NULL!=(p=strsep(&list,",")))
+  {
+    if(NULL!=(col=strchr(p,':'))) *col++='\0';
+    for(i=0;i<sizeof(ops)/sizeof(ops[0])&&0!=strcmp(p,ops[i].name);i++);
+    if(i==sizeof(ops)/sizeof(ops[0])) errx(1, "unknown aggregate '%s'",p);
+    if(NULL==(aggs=realloc(aggs,(naggs+1)*sizeof(struct aggspec)))) err(1, "realloc");
+    aggs[naggs].op=ops[i].op;
+    aggs[naggs].col=-1;
+    if(AG_COUNT!=ops[i].op)
+    {
+      if(NULL==col||0>=(aggs[naggs].col=strtol(col,&end,10)-1)+1||'\0'!=*end) errx(1, "aggregate '%s' needs a field",p);
+    }
+    else if(NULL!=col) errx(1, "aggregate '%s' has no field",p);
+    naggs++;
+  }
+}
+
+/* names in the fields of an -a list
+ */
+static char *names_aggs(struct hdrnames *h, char const *list)
+{
+  struct outbuf o;
+  char *col,*num;
+  size_t n;
+
+  outbuf_init(&o,-1,strlen(list)+1);
+  for(;;)
+  {
+    n=strcspn(list,",");
+    col=memchr(list,':',n);
+    outbuf_write(&o,list,(NULL==col?n:(size_t)(col-list+1)));
+    if(NULL!=col)
+    {
+      if(NULL==(col=strndup(col+1,list+n-col-1))) err(1, "strndup");
+      num=names_subst(h,col,",","",0);
+      outbuf_puts(&o,num);
+      free(num);
+      free(col);
+    }
+    list+=n;
+    if('\0'==*list) break;
+    outbuf_putc(&o,*list++);
+  }
+  outbuf_putc(&o,'\0');
+  return(o.buf);
+}
+
+static int names_has(int opt)
+{
+  int i;
+
+  for(i=0;i<nnamedopts;i++) if(namedopts[i].opt==opt) return(1);
+  return(0);
+}
+
+/* parse the options with column names once, on the header row of the first file,
+   the names have to be in the same columns in the header rows of the other files
+ */
+static void names_setup(char const *fnam, char *hdr, size_t len, char dchar)
+{
+  struct hdrnames h;
+  size_t k;
+  char *list;
+  int i;
+
+  memset(&h,0,sizeof(struct hdrnames));
+  h.n=csvcut_countfields(hdr,len,dchar);
+  if(NULL==(h.flds=calloc(h.n,sizeof(struct ccsv_field)))) err(1, "calloc");
+  h.n=ccsv_split(hdr,len,dchar,h.flds,h.n);
+  pthread_mutex_lock(&namesmtx);
+  if(!namesdone)
+  {
+    for(h.mask=1;h.mask<2*(size_t)h.n;h.mask<<=1);
+    if(NULL==(h.tab=calloc(h.mask,sizeof(int)))) err(1, "calloc");
+    h.mask--;
+    for(i=0;i<h.n;i++)
+    {
+      if(0<=names_find(&h,h.flds[i].str,h.flds[i].len)) continue;
+      for(k=memo_hash(h.flds[i].str,h.flds[i].len)&h.mask;0!=h.tab[k];k=(k+1)&h.mask);
+      h.tab[k]=i+1;
+    }
+    for(i=0;i<nnamedopts;i++)
+    {
+      if('c'==namedopts[i].opt) list=names_subst(&h,namedopts[i].arg,"/,",":",0);
+      else if('a'==namedopts[i].opt) list=names_aggs(&h,namedopts[i].arg);
+      else list=names_subst(&h,namedopts[i].arg,(NULL!=strchr("fg",namedopts[i].opt)?",":",+^*"),"",'f'==namedopts[i].opt);
+      if('f'==namedopts[i].opt) get_list(list);
+      else if('r'==namedopts[i].opt) reorder_fields=parse_rangeset(list);
+      else if('g'==namedopts[i].opt) setup_group(list);
+      else if('a'==namedopts[i].opt) setup_aggs(list);
+      else setup_callout(list);
+      free(list);
+    }
+    free(h.tab);
+    namesdone=1;
+  }
+  for(i=0;i<ncolnames;i++)
+  {
+    if(colnames[i].col>=h.n||h.flds[colnames[i].col].len!=strlen(colnames[i].name)||0!=memcmp(h.flds[colnames[i].col].str,colnames[i].name,h.flds[colnames[i].col].len))
+    {
+      errx(1, "%s: column '%s' is not field %d as in the first file",fnam,colnames[i].name,colnames[i].col+1);
+    }
+  }
+  pthread_mutex_unlock(&namesmtx);
+  free(h.flds);
+}
+
+static void names_free(void)
+{
+  int i;
+
+  for(i=0;i<ncolnames;i++) free(colnames[i].name);
+  if(NULL!=colnames) free(colnames);
+  if(NULL!=namedopts) free(namedopts);
+  if(NULL!=grpcols) free(grpcols);
+  if(NULL!=aggs) free(aggs);
+  grpcols=NULL;
+  aggs=NULL;
+  ngrpcols=naggs=0;
+  colnames=NULL;
+  namedopts=NULL;
+  ncolnames=nnamedopts=0;
+}
+
+/* compile a -w filter
+   COL OP VALUE predicates joined by '&' and alternatives of those separated by '|',
+   '&' binds tighter; a '&' or '|' in a value is escaped by a backslash
+ */
+static void setup_filter(char *arg)
+{
+  static struct { char const *name; enum wop op; } const ops[]=
+  {
+    {"==",W_EQ}, {"!=",W_NE}, {"^=",W_PREFIX}, {"!~",W_NOMATCH}, {"~",W_MATCH},
+    {"<=",W_LE}, {">=",W_GE}, {"<",W_LT}, {">",W_GT},
+  };
+  struct wexpr *w;
+  struct wpred *p;
+  char *s=arg,*v,*end;
+  char msg[256];
+  size_t i;
+  long n;
+  int rc;
+
+  if(NULL==arg)
+  {
+    for(;nfilters>0;nfilters--)
+    {
+      w=&filters[nfilters-1];
+      for(p=w->p;p<&w->p[w->np];p++)
+      {
+        if(W_MATCH==p->op||W_NOMATCH==p->op) regfree(&p->re);
+        free(p->str);
+      }
+      free(w->p);
+      free(w->term);
+    }
+    if(NULL!=filters) free(filters);
+    filters=NULL;
+    return;
+  }
+  if(NULL==(filters=realloc(filters,(nfilters+1)*sizeof(struct wexpr)))) err(1, "realloc");
+  w=&filters[nfilters++];
+  memset(w,0,sizeof(struct wexpr));
+  if(NULL==(w->term=calloc(1,sizeof(int)))) err(1, "calloc");
+  w->nterm=1;
+  for(;;)
+  {
+    n=strtol(s,&end,10);
+    if(end==s||n<1||n>=INT_MAX) errx(1, "bad filter field '%s'",s);
+    s=end;
+    for(i=0;i<sizeof(ops)/sizeof(ops[0])&&0!=strncmp(s,ops[i].name,strlen(ops[i].name));i++);
+    if(i==sizeof(ops)/sizeof(ops[0])) errx(1, "bad filter operator '%s'",s);
+    s+=strlen(ops[i].name);
+    if(NULL==(w->p=realloc(w->p,(w->np+1)*sizeof(struct wpred)))) err(1, "realloc");
+    p=&w->p[w->np++];
+    memset(p,0,sizeof(struct wpred));
+    p->fld=n-1;
+    p->op=ops[i].op;
+    w->term[w->nterm-1]++;
+    if(n>wfldmax) wfldmax=n;
+    if(NULL==(p->str=malloc(strlen(s)+1))) err(1, "malloc");
+    for(v=p->str;'\0'!=*s&&'&'!=*s&&'|'!=*s;s++)
+    {
+      if('\\'==*s&&('&'==s[1]||'|'==s[1])) s++;
+      *v++=*s;
+    }
+    *v='\0';
+    p->len=v-p->str;
+    if(W_MATCH==p->op||W_NOMATCH==p->op)
+    {
+      if(0!=(rc=regcomp(&p->re,p->str,REG_EXTENDED|REG_NOSUB)))
+      {
+        regerror(rc,&p->re,msg,sizeof(msg));
+        errx(1, "bad filter regex '%s': %s",p->str,msg);
+      }
+    }
+    else if(p->op>=W_LT)
+    {
+      p->num=strtod(p->str,&end);
+      if(end==p->str||'\0'!=*end) errx(1, "bad filter number '%s'",p->str);
+    }
+    if('\0'==*s) break;
+    if('|'==*s)
+    {
+      if(NULL==(w->term=realloc(w->term,(w->nterm+1)*sizeof(int)))) err(1, "realloc");
+      w->term[w->nterm++]=0;
+    }
+    s++;
+  }
+}
+
 /* based on cut.c https://github.com/freebsd/freebsd-src/blob/937a0055858a098027f464abf0b2b1ec5d36748f/usr.bin/cut/cut.c
  */
+enum longopt
+{
+  OPT_INDEX=CHAR_MAX+1,
+  OPT_CACHE,
+  OPT_BATCH,
+  OPT_ROWS,
+  OPT_STATS,
+  OPT_COUNT,
+  OPT_GROUPMEM,
+};
+
+static struct option const longopts[]=
+{
+  {"index", optional_argument, NULL, OPT_INDEX},
+  {"cache", no_argument, NULL, OPT_CACHE},
+  {"batch", required_argument, NULL, OPT_BATCH},
+  {"rows", required_argument, NULL, OPT_ROWS},
+  {"stats", no_argument, NULL, OPT_STATS},
+  {"count", no_argument, NULL, OPT_COUNT},
+  {"group-mem", required_argument, NULL, OPT_GROUPMEM},
+  {NULL, 0, NULL, 0}
+};
+
+static void get_rows(char *arg)
+{
+  char *p;
+
+  rowsfrom=strtol(arg,&p,10);
+  rowsto=rowsfrom;
+  if('-'==*p) rowsto=('\0'==*++p?0:strtol(p,&p,10));
+  if(*p||rowsfrom<1||(0!=rowsto&&rowsto<rowsfrom)) errx(1, "bad row range '%s'",arg);
+}
+
 int main(int argc, char *argv[])
 {
   FILE *fp;
   int ch, rval;
   char dchar=','; /* default delimiter is ',' */
+  uint64_t t0=now_ns();
 
-  while ((ch = getopt(argc, argv, "d:f:Hho:D:c:vsqr:")) != -1)
+  while ((ch = getopt_long(argc, argv, "d:f:Hho:D:c:vsqr:j:J:m:P:B:uw:g:a:", longopts, NULL)) != -1)
   {
     switch(ch) 
     {
       case 'c':
-        setup_callout(optarg);
+        names_opt('c',optarg);
         break;
       case 'd':
         dchar = optarg[0];
@@ -773,12 +5316,12 @@ int main(int argc, char *argv[])
         if(Dchar[0] == '\0') errx(1, "bad delimiter");
         break;
       case 'f':
-        if(NULL!=reorder_fields) errx(1, "cannot use -f if -r is used");
-        get_list(optarg);
+        if(NULL!=reorder_fields||names_has('r')) errx(1, "cannot use -f if -r is used");
+        names_opt('f',optarg);
         break;
       case 'r':
-        if(NULL!=positions) errx(1, "cannot use -r if -f is used");
-        reorder_fields=parse_rangeset(optarg);
+        if(NULL!=positions||names_has('f')) errx(1, "cannot use -r if -f is used");
+        names_opt('r',optarg);
         break;
       case 'H':
         Hflag = 1;
@@ -792,6 +5335,60 @@ int main(int argc, char *argv[])
       case 'q':
         qflag = 1;
         break;
+      case 'm':
+        setup_memo(optarg);
+        break;
+      case 'P':
+        pjobs = atoi(optarg);
+        if(pjobs < 1) errx(1, "bad number of parallel callouts");
+        break;
+      case 'j':
+        jobs = atoi(optarg);
+        if(jobs < 1) errx(1, "bad number of jobs");
+        break;
+      case 'J':
+        fjobs = atoi(optarg);
+        if(fjobs < 1) errx(1, "bad number of files");
+        break;
+      case 'B':
+        outbufsiz = strtoul(optarg, NULL, 10);
+        if(outbufsiz < 1) errx(1, "bad buffer size");
+        break;
+      case 'u':
+        uflag = 1;
+        break;
+      case 'w':
+        setup_filter(optarg);
+        break;
+      case OPT_INDEX:
+        xflag = 1;
+        if(NULL!=optarg&&(idxstep = strtoul(optarg, NULL, 10)) < 1) errx(1, "bad index step");
+        break;
+      case OPT_CACHE:
+        Cflag = 1;
+        break;
+      case OPT_BATCH:
+        batchrows = atol(optarg);
+        if(batchrows < 1) errx(1, "bad batch size");
+        break;
+      case OPT_ROWS:
+        get_rows(optarg);
+        break;
+      case OPT_STATS:
+        statsflag = 1;
+        break;
+      case OPT_COUNT:
+        countflag = 1;
+        break;
+      case OPT_GROUPMEM:
+        groupmem = strtoul(optarg, NULL, 10);
+        if(groupmem < 1) errx(1, "bad group memory");
+        break;
+      case 'g':
+      case 'a':
+        gflag = 1;
+        names_opt(ch, optarg);
+        break;
       case 'h':
         usage(argv[0],0);
         break;
@@ -805,25 +5402,61 @@ int main(int argc, char *argv[])
   }
   argc -= optind;
   argv += optind;
+  if(jobs>1&&pjobs>0) errx(1, "cannot use -P if -j is used");
+  if(gflag&&(NULL!=positions||NULL!=reorder_fields||names_has('f')||names_has('r'))) errx(1, "cannot use -f or -r if -g or -a is used");
+  if(gflag&&jobs>1) errx(1, "cannot use -j if -g or -a is used");
+  /* without -a the rows of each group are counted */
+  if(gflag&&!names_has('a')) names_opt('a', "count");
+  outbuf_init(&stdoutbuf,STDOUT_FILENO,outbufsiz);
+  atexit(stdoutbuf_flush);
 
   rval = 0;
-  if (*argv)
+  if (xflag || Cflag) {
+    if (!*argv) errx(1, "--index and --cache need file arguments");
+    for (; *argv; ++argv) {
+      if (!(fp = fopen(*argv, "r"))) {
+        warn("%s", *argv);
+        rval = 1;
+        continue;
+      }
+      if (xflag)
+        rval |= index_build(fp, *argv, dchar);
+      if (Cflag) {
+        rewind(fp);
+        rval |= cache_build(fp, *argv, dchar);
+      }
+      (void)fclose(fp);
+    }
+  }
+  else if (fjobs > 1 && argc > 1)
+    rval = cut_files(argv, argc, dchar);
+  else if (*argv)
     for (; *argv; ++argv) {
       if (strcmp(*argv, "-") == 0)
-        rval |= csv_cut(stdin, "stdin", dchar);
+        rval |= csv_cut(stdin, "stdin", dchar, &stdoutbuf);
       else {
         if (!(fp = fopen(*argv, "r"))) {
           warn("%s", *argv);
           rval = 1;
           continue;
         }
-        csv_cut(fp, *argv, dchar);
+        csv_cut(fp, *argv, dchar, &stdoutbuf);
         (void)fclose(fp);
       }
     }
-  else rval = csv_cut(stdin, "stdin", dchar);
+  else rval = csv_cut(stdin, "stdin", dchar, &stdoutbuf);
+  if (statsflag) {
+    outbuf_flush(&stdoutbuf);
+    stats_print((now_ns() - t0) / 1e9);
+  }
   setup_callout(NULL);
+  setup_memo(NULL);
+  setup_filter(NULL);
+  names_free();
   if(NULL!=cb_pass_fld) free(cb_pass_fld);
   if(NULL!=reorder_fields) free(reorder_fields);
+  if(NULL!=positions) free(positions);
+  outbuf_flush(&stdoutbuf);
+  outbuf_free(&stdoutbuf);
   exit(rval);
 }
@@ -0,0 +1,70 @@
+/* csvcut.h
+   the record reader, field splitter and column selection of csvcut as a library
+
+   struct csvcut *c=csvcut_new(',',row,arg);
+   csvcut_select(c,"3,1,5-");
+   while(0<(n=read(fd,buf,sizeof(buf)))&&0==csvcut_feed(c,buf,n));
+   csvcut_finish(c);
+   csvcut_free(c);
+
+   The input is pushed in buffers of any size, records may span buffers and
+   quoted fields may contain line breaks. row() is called for each record with
+   the selected fields, the header row is line 1:
+
+   int row(void *arg, long lineno, struct csvcut_field const *fld, int n);
+
+   The fields point into the buffer passed to csvcut_feed() or into a copy of
+   a record spanning buffers and are only valid during the call. Quotes around
+   a field are removed, doubled quotes inside it are not. A selected field
+   missing from the record has a NULL str. A non-zero return value stops the
+   parser, csvcut_feed() and csvcut_finish() return it from then on.
+
+   A context is used by one thread at a time, any number of them can be used
+   at the same time. The functions returning int return -1 and set errno on
+   errors, nothing is printed and the process is never terminated.
+ */
+#ifndef CSVCUT_H
+#define CSVCUT_H
+
+#include <stddef.h>
+
+struct csvcut;
+
+struct csvcut_field
+{
+  char const *str;
+  size_t len;
+  int quoted;
+};
+
+typedef int (*csvcut_row_fn)(void *arg, long lineno, struct csvcut_field const *fld, int n);
+
+/* a parser of delim separated records calling fn for each of them */
+struct csvcut *csvcut_new(char delim, csvcut_row_fn fn, void *arg);
+
+/* fields in output order like -r: N, N-M, N- and -M counted from 1, open ranges end at the
+   last field of the header row, NULL or "" selects every field of each record
+   has to be called before the first record, EINVAL for a wrong list */
+int csvcut_select(struct csvcut *c, char const *list);
+
+/* parse a buffer, an incomplete record at the end is kept for the next call */
+int csvcut_feed(struct csvcut *c, char const *buf, size_t len);
+
+/* parse the kept record at the end of the input, which has no line terminator */
+int csvcut_finish(struct csvcut *c);
+
+void csvcut_free(struct csvcut *c);
+
+/* the scanning functions of the parser, which csvcut uses for its own reader as well */
+
+/* the quotes in [str,end) */
+size_t csvcut_countquotes(char const *str, char const *end);
+
+/* the fields of a record, delimiters inside quotes are not counted */
+int csvcut_countfields(char const *str, size_t len, char delim);
+
+/* the newline ending a record in [str,end) or NULL, *inq is the parity of the quotes of the
+   record before str and is updated, it is 0 when a newline is returned */
+char const *csvcut_recend(char const *str, char const *end, int *inq);
+
+#endif
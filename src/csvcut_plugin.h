@@ -0,0 +1,39 @@
+/* csvcut_plugin.h
+   interface of the shared object callouts of csvcut
+
+   -c 3:plugin:./libfoo.so:foo
+
+   loads libfoo.so once and calls foo() for each value of the 3rd column.
+
+   int foo(void *state, int col, int prcol, char const *fname, char const *value,
+           int argc, char const * const *argv, char *out, size_t *outlen);
+
+   col, prcol, fname and value are the arguments of a callout command and
+   argv holds the argc values of the additional fields.
+   *outlen is the size of out on entry and has to be set to the length of
+   the new value. If it does not fit, csvcut grows the buffer to *outlen+1
+   bytes and calls the function again. The value is not changed if the
+   length is 0. A non-zero return value disables the callout like a failing
+   command.
+
+   Optional hooks:
+
+   int foo_init(void **state);   called once after loading, non-zero is fatal
+   void foo_finish(void *state); called once before unloading
+
+   The function may be called from several threads at once with -j.
+ */
+#ifndef CSVCUT_PLUGIN_H
+#define CSVCUT_PLUGIN_H
+
+#include <stddef.h>
+
+#define CSVCUT_PLUGIN_INIT   "_init"
+#define CSVCUT_PLUGIN_FINISH "_finish"
+
+typedef int (*csvcut_plugin_fn)(void *state, int col, int prcol, char const *fname, char const *value,
+                                int argc, char const * const *argv, char *out, size_t *outlen);
+typedef int (*csvcut_plugin_init_fn)(void **state);
+typedef void (*csvcut_plugin_finish_fn)(void *state);
+
+#endif
@@ -0,0 +1,315 @@
+/*
+  BSD 3-Clause License
+
+  Copyright (c) 2024, Gergely Gati
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  3. Neither the name of the copyright holder nor the names of its
+     contributors may be used to endorse or promote products derived from
+     this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+/* libcsvcut: the csv reader of csvcut behind an explicit context, see csvcut.h
+   csvcut links it for the record boundaries and field counts, so both read records alike
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "ccsv.h"
+#include "csvcut.h"
+
+/* a range of the selection, 0 is open */
+struct selrange
+{
+  int min,max;
+};
+
+struct csvcut
+{
+  char delim;
+  csvcut_row_fn fn;
+  void *arg;
+  struct selrange *sel;  /* ranges of csvcut_select() */
+  int nsel;
+  int *idx;              /* input field of each output column, compiled at the header */
+  int nidx;
+  int nsplit;            /* fields needed from a record */
+  struct ccsv_field *flds;
+  int fldsiz;
+  struct csvcut_field *out;
+  int outsiz;
+  char *buf;             /* a record spanning buffers */
+  size_t len,siz;
+  int quotes;            /* parity of the quotes in buf */
+  long lineno;
+  int stop;              /* return value of the callback stopping the parser */
+};
+
+size_t csvcut_countquotes(char const *str, char const *end)
+{
+  size_t ret;
+  for(ret=0;NULL!=(str=memchr(str,'"',end-str));str++) ret++;
+  return(ret);
+}
+
+int csvcut_countfields(char const *str, size_t len, char delim)
+{
+  char const *end=str+len;
+  int ret,q;
+  for(ret=1,q=0;str<end;str++)
+  {
+    if(*str==delim&&0==q) ret++;
+    if(*str=='"') q^=1;
+  }
+  return(ret);
+}
+
+char const *csvcut_recend(char const *str, char const *end, int *inq)
+{
+  char const *nl;
+
+  /* the quotes are counted up to each newline, the record ends at the first one after an
+     even number of them */
+  for(;NULL!=(nl=memchr(str,'\n',end-str));str=nl+1)
+  {
+    *inq^=csvcut_countquotes(str,nl)&1;
+    if(0==*inq) return(nl);
+  }
+  *inq^=csvcut_countquotes(str,end)&1;
+  return(NULL);
+}
+
+static int grow(void **p, int *siz, int n, size_t elsiz)
+{
+  void *np;
+
+  if(n<=*siz) return(0);
+  if(NULL==(np=realloc(*p,n*elsiz))) return(-1);
+  *p=np;
+  *siz=n;
+  return(0);
+}
+
+struct csvcut *csvcut_new(char delim, csvcut_row_fn fn, void *arg)
+{
+  struct csvcut *c;
+
+  if('\0'==delim||'"'==delim||'\n'==delim||NULL==fn)
+  {
+    errno=EINVAL;
+    return(NULL);
+  }
+  if(NULL==(c=calloc(1,sizeof(struct csvcut)))) return(NULL);
+  c->delim=delim;
+  c->fn=fn;
+  c->arg=arg;
+  return(c);
+}
+
+int csvcut_select(struct csvcut *c, char const *list)
+{
+  struct selrange *sel=NULL,*r;
+  char const *p=list;
+  char *e;
+  int n=0,t,bad=(c->lineno>0);
+
+  while(!bad&&NULL!=p&&'\0'!=*p)
+  {
+    if(NULL==(r=realloc(sel,(n+1)*sizeof(struct selrange))))
+    {
+      free(sel);
+      return(-1);
+    }
+    sel=r;
+    r=&sel[n++];
+    if('-'==*p)
+    {
+      r->min=1;
+      r->max=strtol(++p,&e,10);
+      bad=(e==p);
+    }
+    else
+    {
+      r->min=r->max=strtol(p,&e,10);
+      bad=(e==p);
+      if('-'==*e)
+      {
+        p=e+1;
+        r->max=('0'<=*p&&*p<='9'?strtol(p,&e,10):0);
+        if(0==r->max) e=(char *)p;
+      }
+    }
+    p=e;
+    if(bad||r->min<1||(','==*p&&'\0'==*++p)||(','!=p[-1]&&'\0'!=*p)) bad=1;
+    if(0!=r->max&&r->max<r->min)
+    {
+      /* reversed like -r */
+      t=r->min;
+      r->min=r->max;
+      r->max=t;
+    }
+  }
+  if(bad)
+  {
+    free(sel);
+    errno=EINVAL;
+    return(-1);
+  }
+  free(c->sel);
+  c->sel=sel;
+  c->nsel=n;
+  return(0);
+}
+
+/* the output columns of the selection for the fields of the header row
+ */
+static int compile(struct csvcut *c, int fldnum)
+{
+  struct selrange *r;
+  int i,n,max;
+
+  for(n=0,r=c->sel;r<c->sel+c->nsel;r++) n+=(0==r->max?(fldnum>=r->min?fldnum-r->min+1:0):r->max-r->min+1);
+  if(NULL==(c->idx=malloc((n+1)*sizeof(int)))) return(-1);
+  c->nidx=0;
+  c->nsplit=0;
+  for(r=c->sel;r<c->sel+c->nsel;r++)
+  {
+    /* fields after the last one of the header are left out like with -r */
+    max=(0==r->max||r->max>fldnum?fldnum:r->max);
+    for(i=r->min;i<=max;i++)
+    {
+      c->idx[c->nidx++]=i-1;
+      if(i>c->nsplit) c->nsplit=i;
+    }
+  }
+  if(grow((void **)&c->out,&c->outsiz,c->nidx,sizeof(struct csvcut_field))) return(-1);
+  return(grow((void **)&c->flds,&c->fldsiz,c->nsplit,sizeof(struct ccsv_field)));
+}
+
+/* split a record and pass the selected fields to the callback
+ */
+static int record(struct csvcut *c, char const *rec, size_t len)
+{
+  struct ccsv_field *f;
+  int i,k,n;
+
+  if(1==++c->lineno&&NULL!=c->sel&&compile(c,csvcut_countfields(rec,len,c->delim))) return(c->stop=-1);
+  if(NULL!=c->sel)
+  {
+    n=ccsv_split((char *)rec,len,c->delim,c->flds,c->nsplit);
+    for(k=0;k<c->nidx;k++)
+    {
+      if((i=c->idx[k])<n)
+      {
+        f=&c->flds[i];
+        c->out[k].str=f->str;
+        c->out[k].len=f->len;
+        c->out[k].quoted=('"'==f->type);
+      }
+      else memset(&c->out[k],0,sizeof(struct csvcut_field));
+    }
+    n=c->nidx;
+  }
+  else
+  {
+    /* every field, the arrays grow to the longest record */
+    while((n=ccsv_split((char *)rec,len,c->delim,c->flds,c->fldsiz))==c->fldsiz)
+    {
+      if(grow((void **)&c->flds,&c->fldsiz,(0==c->fldsiz?16:2*c->fldsiz),sizeof(struct ccsv_field))) return(c->stop=-1);
+    }
+    if(grow((void **)&c->out,&c->outsiz,n,sizeof(struct csvcut_field))) return(c->stop=-1);
+    for(k=0;k<n;k++)
+    {
+      c->out[k].str=c->flds[k].str;
+      c->out[k].len=c->flds[k].len;
+      c->out[k].quoted=('"'==c->flds[k].type);
+    }
+  }
+  return(c->stop=c->fn(c->arg,c->lineno,c->out,n));
+}
+
+/* keep the end of a buffer for the next one
+ */
+static int keep(struct csvcut *c, char const *p, size_t len)
+{
+  char *nb;
+  size_t siz;
+
+  if(c->len+len>c->siz)
+  {
+    for(siz=(0==c->siz?1024:c->siz);siz<c->len+len;siz*=2);
+    if(NULL==(nb=realloc(c->buf,siz))) return(-1);
+    c->buf=nb;
+    c->siz=siz;
+  }
+  memcpy(&c->buf[c->len],p,len);
+  c->len+=len;
+  return(0);
+}
+
+int csvcut_feed(struct csvcut *c, char const *buf, size_t len)
+{
+  char const *end=buf+len,*nl,*rec;
+  size_t n;
+
+  if(0!=c->stop) return(c->stop);
+  /* the records complete in the buffer are not copied */
+  for(rec=buf;NULL!=(nl=csvcut_recend(rec,end,&c->quotes));rec=nl+1)
+  {
+    if(c->len>0)
+    {
+      if(keep(c,rec,nl-rec)) return(c->stop=-1);
+      n=c->len;
+      c->len=0;
+      if(record(c,c->buf,n)) return(c->stop);
+    }
+    else if(record(c,rec,nl-rec)) return(c->stop);
+  }
+  if(keep(c,rec,end-rec)) return(c->stop=-1);
+  return(0);
+}
+
+int csvcut_finish(struct csvcut *c)
+{
+  size_t n;
+
+  if(0!=c->stop) return(c->stop);
+  if(0==c->len) return(0);
+  n=c->len;
+  c->len=0;
+  c->quotes=0;
+  return(record(c,c->buf,n));
+}
+
+void csvcut_free(struct csvcut *c)
+{
+  if(NULL==c) return;
+  free(c->sel);
+  free(c->idx);
+  free(c->flds);
+  free(c->out);
+  free(c->buf);
+  free(c);
+}
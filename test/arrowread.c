@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* reads an Arrow IPC stream of string columns written by csvcut -o arrow from stdin
+   and prints the rows like csvcut -H does: quoted values, missing values left out
+   -n prints the column names first
+ */
+
+static unsigned char *buf;
+static size_t len;
+
+static void fail(char const *msg)
+{
+  fprintf(stderr,"arrowread: %s\n",msg);
+  exit(1);
+}
+
+static uint64_t le(unsigned char const *p, int size)
+{
+  uint64_t v=0;
+
+  if(p<buf||p+size>buf+len) fail("offset out of the stream");
+  while(size-->0) v=(v<<8)|p[size];
+  return(v);
+}
+
+/* field of a flatbuffer table or NULL if it is not set
+ */
+static unsigned char const *field(unsigned char const *tbl, int id)
+{
+  unsigned char const *vt=tbl-(int32_t)le(tbl,4);
+  unsigned off;
+
+  if(4+2*id>=(int)le(vt,2)) return(NULL);
+  off=le(vt+4+2*id,2);
+  return(0==off?NULL:tbl+off);
+}
+
+static unsigned char const *deref(unsigned char const *p)
+{
+  if(NULL==p) fail("missing table");
+  return(p+le(p,4));
+}
+
+static void print_batch(unsigned char const *rb, unsigned char const *body, int ncols)
+{
+  unsigned char const *nodes,*bufs,*val,*offs,*data;
+  uint64_t rows,i,o0,o1,c;
+  int sep;
+
+  rows=le(field(rb,0),8);
+  nodes=deref(field(rb,1));
+  bufs=deref(field(rb,2));
+  if((int)le(nodes,4)!=ncols||(int)le(bufs,4)!=3*ncols) fail("bad record batch");
+  for(i=0;i<rows;i++)
+  {
+    for(sep=0,c=0;c<(uint64_t)ncols;c++)
+    {
+      if(le(nodes+4+16*c,8)!=rows) fail("bad column length");
+      val=body+le(bufs+4+48*c,8);
+      offs=body+le(bufs+4+48*c+16,8);
+      data=body+le(bufs+4+48*c+32,8);
+      if(0!=le(bufs+4+48*c+8,8)&&0==(le(val+i/8,1)&(1<<(i%8)))) continue;
+      o0=le(offs+4*i,4);
+      o1=le(offs+4*i+4,4);
+      if(o1<o0) fail("bad offsets");
+      le(data+o1-1,o1>o0?1:0);
+      if(sep++) putchar(',');
+      putchar('"');
+      for(;o0<o1;o0++)
+      {
+        if('"'==data[o0]) putchar('"');
+        putchar(data[o0]);
+      }
+      putchar('"');
+    }
+    putchar('\n');
+  }
+}
+
+int main(int argc, char **argv)
+{
+  unsigned char const *p,*msg,*hdr,*flds,*f,*name;
+  size_t siz=0,n,metalen;
+  int ncols=-1,names=(argc>1&&0==strcmp(argv[1],"-n"));
+  uint64_t i;
+
+  while(!feof(stdin))
+  {
+    if(len==siz&&NULL==(buf=realloc(buf,siz=siz*2+65536))) fail("out of memory");
+    len+=fread(buf+len,1,siz-len,stdin);
+  }
+  for(p=buf;;p+=metalen+le(field(msg,3),8))
+  {
+    if(0xffffffff!=le(p,4)) fail("no continuation marker");
+    if(0==(metalen=le(p+4,4))) break;
+    if(0!=metalen%8) fail("unaligned metadata");
+    p+=8;
+    msg=deref(p);
+    if(4!=le(field(msg,0),2)) fail("not a V5 message");
+    hdr=deref(field(msg,2));
+    switch(le(field(msg,1),1))
+    {
+      case 1:
+        if(ncols>=0) fail("second schema");
+        flds=deref(field(hdr,1));
+        ncols=le(flds,4);
+        for(i=0;i<(uint64_t)ncols;i++)
+        {
+          f=deref(flds+4+4*i);
+          if(5!=le(field(f,2),1)) fail("not a string column");
+          name=deref(field(f,0));
+          n=le(name,4);
+          le(name+4,n+1);
+          if(names) printf("%s%.*s",(i>0?",":"# "),(int)n,name+4);
+        }
+        if(names) putchar('\n');
+        break;
+      case 3:
+        if(ncols<0) fail("record batch before the schema");
+        print_batch(hdr,p+metalen,ncols);
+        break;
+      default:
+        fail("unexpected message");
+    }
+  }
+  return(0);
+}
@@ -0,0 +1,91 @@
+#!/bin/bash
+
+# throughput of typical csvcut runs on generated files, run by make bench
+# prints one json object per scenario: input bytes and rows, best time of BENCH_RUNS runs, MB/s and rows/s
+#
+# BENCH_ROWS  rows of the generated files (1000000)
+# BENCH_RUNS  runs of each scenario (3)
+# BENCH_DIR   directory of the generated files, kept if it is given
+
+WHERE=$(cd "$(dirname "$0")" && pwd)
+BUILD=$(pwd)
+CSVCUT=${CSVCUT:-"$BUILD/../src/csvcut"}
+CSVGEN=${CSVGEN:-"$BUILD/csvgen"}
+PROCFIELD="$BUILD/procfield"
+ROWS=${BENCH_ROWS:-1000000}
+RUNS=${BENCH_RUNS:-3}
+
+if [ x"$BENCH_DIR" == x"" ]; then
+  DIR=$(mktemp -d)
+  trap 'rm -rf "$DIR"' EXIT
+else
+  DIR=$BENCH_DIR
+  mkdir -p "$DIR"
+fi
+
+# name and csvgen arguments of the data sets
+data=(
+    "plain|-c 12 -l 8"
+    "quoted|-c 12 -l 8 -q 20 -n 5"
+    "wide|-c 100 -l 4"
+    "semicolon|-c 12 -l 8 -q 10 -d ;"
+)
+
+# name, data set and csvcut arguments of the scenarios, the arguments are evaluated by the shell
+scenarios=(
+    "project|plain|-f 1,3,5"
+    "project-all|plain|-f 1-"
+    "project-span|plain|-q -f 1-10"
+    "project-quoted|quoted|-f 2,7-9"
+    "project-wide|wide|-f 1,50,99"
+    "reorder|plain|-r '5,1^2,3*4*6,7-'"
+    "reorder-quoted|quoted|-r '9-,2*3,1'"
+    "json|plain|-o json -f 1-6"
+    "json-quoted|quoted|-o json -f 1-6"
+    "ndjson-quoted|quoted|-o ndjson -r 6,1-4"
+    "xml|plain|-o xml -f 1-6"
+    "delimiter|semicolon|-d ';' -D : -f 2-"
+    "filter|plain|-w '1<$((ROWS/2))' -f 1,2"
+    "callout-builtin|plain|-f 1-3 -c 2:@upper"
+    "callout-coproc|plain|-f 1-3 -c '2:coproc:$PROCFIELD -s'"
+    "jobs|plain|-j $(nproc 2>/dev/null || echo 2) -f 1,3,5"
+    "count-quoted|quoted|--count"
+    "group|plain|-g 2 -a count,sum:1"
+)
+
+for d in "${data[@]}"; do
+  name=${d%%|*}
+  if [ ! -s "$DIR/$name.csv" ]; then
+    $CSVGEN -r $ROWS ${d#*|} > "$DIR/$name.csv" || exit 1
+  fi
+done
+
+now() {
+  date +%s%N
+}
+
+RESP=0
+for s in "${scenarios[@]}"; do
+  IFS='|' read -r name set args <<< "$s"
+  file="$DIR/$set.csv"
+  bytes=$(wc -c < "$file")
+  best=0
+  for((i=0;i<RUNS;i++)); do
+    t0=$(now)
+    if ! eval "\"\$CSVCUT\" $args \"\$file\"" > /dev/null; then
+      echo "bench: $name failed" >&2
+      RESP=1
+      continue 2
+    fi
+    t=$(( $(now) - t0 ))
+    if [ $best -eq 0 ] || [ $t -lt $best ]; then best=$t; fi
+  done
+  awk -v name="$name" -v args="$args" -v set="$set" -v bytes="$bytes" -v rows="$ROWS" -v ns="$best" 'BEGIN {
+    gsub(/\\/,"\\\\",args); gsub(/"/,"\\\"",args);
+    s=ns/1e9;
+    printf("{\"name\":\"%s\",\"data\":\"%s\",\"args\":\"%s\",\"bytes\":%d,\"rows\":%d,\"seconds\":%.4f,\"mb_s\":%.1f,\"rows_s\":%.0f}\n",
+           name, set, args, bytes, rows, s, bytes/1e6/s, rows/s);
+  }'
+done
+
+exit $RESP
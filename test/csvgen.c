@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+/* writes a deterministic csv file for the benchmarks to stdout
+   the first column is the row number, the others are random words of about the given length
+   a share of the fields is quoted with an embedded delimiter and quote, or with a line break
+
+   csvgen [-r rows] [-c columns] [-l length] [-q quoted%] [-n newline%] [-d delim] [-s seed]
+ */
+
+static uint64_t seed=88172645463325252ULL;
+
+static uint64_t rnd(void)
+{
+  /* xorshift64 */
+  seed^=seed<<13;
+  seed^=seed>>7;
+  seed^=seed<<17;
+  return(seed);
+}
+
+static void usage(char *argv0)
+{
+  fprintf(stderr,"usage: %s [-r rows] [-c columns] [-l length] [-q quoted%%] [-n newline%%] [-d delim] [-s seed]\n",argv0);
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  static const char alpha[]="abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+  long rows=100000,r;
+  int cols=10,flen=8,quoted=0,newline=0,c,i,n,ch;
+  char delim=',';
+  char word[1024];
+
+  while((ch=getopt(argc,argv,"r:c:l:q:n:d:s:"))!=-1)
+  {
+    switch(ch)
+    {
+      case 'r': rows=atol(optarg); break;
+      case 'c': cols=atoi(optarg); break;
+      case 'l': flen=atoi(optarg); break;
+      case 'q': quoted=atoi(optarg); break;
+      case 'n': newline=atoi(optarg); break;
+      case 'd': delim=optarg[0]; break;
+      case 's': seed=strtoull(optarg,NULL,10)|1; break;
+      default: usage(argv[0]);
+    }
+  }
+  if(rows<0||cols<1||flen<1||2*flen>(int)sizeof(word)||quoted<0||newline<0||quoted+newline>100||'\0'==delim||'"'==delim) usage(argv[0]);
+  for(c=0;c<cols;c++)
+  {
+    if(c>0) putchar(delim);
+    printf("col%d",c+1);
+  }
+  putchar('\n');
+  for(r=1;r<=rows;r++)
+  {
+    printf("%ld",r);
+    for(c=1;c<cols;c++)
+    {
+      putchar(delim);
+      n=1+rnd()%(2*flen-1);
+      for(i=0;i<n;i++) word[i]=alpha[rnd()%(sizeof(alpha)-1)];
+      word[n]='\0';
+      i=rnd()%100;
+      if(i<quoted) printf("\"%.*s%c\"\"%s\"",n/2,word,delim,&word[n/2]);
+      else if(i<quoted+newline) printf("\"%.*s\n%s\"",n/2,word,&word[n/2]);
+      else fputs(word,stdout);
+    }
+    putchar('\n');
+  }
+  return(ferror(stdout)||fflush(stdout)?1:0);
+}
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "csvcut.h"
+
+/* feeds a file to libcsvcut in buffers of 1 to chunk bytes and prints the rows like
+   csvcut -r list does, -n stops after that many rows
+ */
+
+static long stop=0;
+
+static int row(void *arg, long lineno, struct csvcut_field const *fld, int n)
+{
+  int i;
+
+  (void)arg;
+  for(i=0;i<n;i++) printf("%s\"%.*s\"",(i>0?",":""),(int)fld[i].len,(NULL==fld[i].str?"":fld[i].str));
+  putchar('\n');
+  return(lineno==stop?2:0);
+}
+
+int main(int argc, char *argv[])
+{
+  struct csvcut *c;
+  char *list=NULL,delim=',';
+  char *buf;
+  size_t chunk=4096,len,n,i;
+  FILE *fp;
+  int ch,st=0;
+
+  while((ch=getopt(argc,argv,"b:d:s:n:"))!=-1)
+  {
+    switch(ch)
+    {
+      case 'b': chunk=strtoul(optarg,NULL,10); break;
+      case 'd': delim=optarg[0]; break;
+      case 's': list=optarg; break;
+      case 'n': stop=atol(optarg); break;
+      default: return(1);
+    }
+  }
+  if(optind>=argc||chunk<1||NULL==(fp=fopen(argv[optind],"r"))) return(1);
+  if(NULL==(buf=malloc(chunk))||NULL==(c=csvcut_new(delim,row,NULL))) return(1);
+  if(0!=csvcut_select(c,list))
+  {
+    perror("csvcut_select");
+    return(1);
+  }
+  for(i=0;0==st;i++)
+  {
+    len=1+(i*7)%chunk;
+    if(0==(n=fread(buf,1,len,fp))) break;
+    st=csvcut_feed(c,buf,n);
+  }
+  if(0==st) st=csvcut_finish(c);
+  if(st!=(stop>0?2:0)) fprintf(stderr,"libfeed: returned %d\n",st);
+  csvcut_free(c);
+  free(buf);
+  fclose(fp);
+  return(st!=(stop>0?2:0));
+}
@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* LD_PRELOAD counter of the heap allocations, printed to stderr at exit
+ */
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+
+static unsigned long allocs=0;
+
+void *malloc(size_t n)
+{
+  __atomic_add_fetch(&allocs,1,__ATOMIC_RELAXED);
+  return(__libc_malloc(n));
+}
+
+void *calloc(size_t n, size_t s)
+{
+  __atomic_add_fetch(&allocs,1,__ATOMIC_RELAXED);
+  return(__libc_calloc(n,s));
+}
+
+void *realloc(void *p, size_t n)
+{
+  __atomic_add_fetch(&allocs,1,__ATOMIC_RELAXED);
+  return(__libc_realloc(p,n));
+}
+
+__attribute__((destructor)) static void report(void)
+{
+  char str[64];
+  int n=snprintf(str,sizeof(str),"allocations: %lu\n",allocs);
+  if(n>0) (void)!write(STDERR_FILENO,str,n);
+}
@@ -3,19 +3,54 @@
 #include <stdlib.h>
 #include <string.h>
 
-int main(int argc, char **argv)
+static void procfield(int argc, char **argv)
 {
   char *p;
   int lcp;
-  
+
+  lcp=0;
+  if(argc>5) lcp=atoi(&argv[5][strlen(argv[5])-1])%2;
+  if(lcp==0) for(p=&argv[4][0];*p;p++) *p=toupper(*p);
+  else       for(p=&argv[4][0];*p;p++) *p=tolower(*p);
+}
+
+/* coprocess mode (-s): serve framed requests from stdin until eof
+   request:  "<argc>\n" and each argument as "<length>\n<bytes>\n"
+   response: "<status> <length>\n<bytes>"
+ */
+static int coproc(void)
+{
+  char *argv[64];
+  size_t len;
+  int argc,i;
+
+  while(1==scanf("%d\n",&argc))
+  {
+    if(argc<0||argc+1>(int)(sizeof(argv)/sizeof(argv[0]))) return(1);
+    argv[0]="procfield";
+    for(i=1;i<=argc;i++)
+    {
+      if(1!=scanf("%zu",&len)||'\n'!=getchar()) return(1);
+      if(NULL==(argv[i]=malloc(len+1))) return(1);
+      if(len!=fread(argv[i],1,len,stdin)||'\n'!=getchar()) return(1);
+      argv[i][len]='\0';
+    }
+    if(argc+1>=5) procfield(argc+1,argv);
+    printf("0 %zu\n%s",(argc+1>=5?strlen(argv[4]):0),(argc+1>=5?argv[4]:""));
+    fflush(stdout);
+    for(i=1;i<=argc;i++) free(argv[i]);
+  }
+  return(0);
+}
+
+int main(int argc, char **argv)
+{
   /* col,prcol,fname,field */
   
+  if(argc==2&&0==strcmp(argv[1],"-s")) return(coproc());
   if(argc>=5)
   {
-    lcp=0;
-    if(argc>5) lcp=atoi(&argv[5][strlen(argv[5])-1])%2;
-    if(lcp==0) for(p=&argv[4][0];*p;p++) *p=toupper(*p);
-    else       for(p=&argv[4][0];*p;p++) *p=tolower(*p);
+    procfield(argc,argv);
     printf("%s",argv[4]);
   }
   
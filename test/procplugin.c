@@ -0,0 +1,39 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "csvcut_plugin.h"
+
+/* plugin version of procfield: upper case unless the last digit of the first extra value is odd
+   the state counts the calls
+ */
+int procplugin_init(void **state)
+{
+  return(NULL==(*state=calloc(1,sizeof(unsigned long))));
+}
+
+void procplugin_finish(void *state)
+{
+  free(state);
+}
+
+int procplugin(void *state, int col, int prcol, char const *fname, char const *value,
+               int argc, char const * const *argv, char *out, size_t *outlen)
+{
+  size_t i,len=strlen(value);
+  int lcp=0;
+
+  (void)col;
+  (void)prcol;
+  (void)fname;
+  __atomic_add_fetch((unsigned long *)state,1,__ATOMIC_RELAXED);
+  if(len>*outlen)
+  {
+    *outlen=len;
+    return(0);
+  }
+  if(argc>0&&'\0'!=argv[0][0]) lcp=atoi(&argv[0][strlen(argv[0])-1])%2;
+  for(i=0;i<len;i++) out[i]=(lcp==0?toupper((unsigned char)value[i]):tolower((unsigned char)value[i]));
+  *outlen=len;
+  return(0);
+}
@@ -25,6 +25,29 @@ tests=(
     "-H -c 4/1:$WHERE/procfield customers-100.csv"		#10
     "-r 7-,1,3-4,-2 -H $WHERE/organizations-100.csv"		#11
     "-r -1,2^3^5,1*1*1,1*2*9 -H $WHERE/organizations-100.csv"   #12
+    "-j 4 -o json -f12-,1 -d ';' $WHERE/FinancialSample.csv"		#13
+    "-j 3 -H -f 2-4 -c 3:$WHERE/procfield $WHERE/customers-100.csv"		#14
+    "-H -f 3-4,11 -c '3-4/11:coproc:$WHERE/procfield -s' $WHERE/customers-100.csv"		#15
+    "-m 16 -H -f 7,3 -c 7:$WHERE/procfield $WHERE/customers-100.csv"		#16
+    "-P 4 -H -f 3-4,11 -c 3-4/11:$WHERE/procfield $WHERE/customers-100.csv"		#17
+    "-H -f 2-4 -c 2-4:@upper $WHERE/customers-100.csv"		#18
+    "-H -f 2-5 -c '2:@lower@substr(1,3)@prefix(<)@suffix(>)' -c '3/4:@join( - )' -c '5:@replace(/ /_/)@trim' $WHERE/customers-100.csv"		#19
+    "-H -f 3-4,11 -c '3-4/11:plugin:$WHERE/procplugin.so:procplugin' $WHERE/customers-100.csv"		#20
+    "-B 10 -u -o xml -f 2,4 $WHERE/customers-100.csv"		#21
+    "-o json -r 7-,1,3-4,-2 -H $WHERE/organizations-100.csv"		#22
+    "-f 2,4 $WHERE/organizations-100.csv $WHERE/customers-100.csv"		#23
+    "-H -f 1,3,7 -w '1<=20&7~^[A-C]|3^=Pr' -w '1!=5' $WHERE/customers-100.csv"		#24
+    "-o json -r 3,1 -w '12~\.com/$' -w '7!=Chile' -c 3:@upper $WHERE/customers-100.csv"		#25
+    "-H -f 1,3 --rows 10-20 $WHERE/customers-100.csv"		#26
+    "-J 2 -o json -f 1,3 $WHERE/customers-100.csv $WHERE/organizations-100.csv $WHERE/customers-100.csv"		#27
+    "-o ndjson -r 3,1^2,4+5,7- $WHERE/customers-100.csv"		#28
+    "-q -f 2-6 $WHERE/organizations-100.csv"		#29
+    "-r '7Country,-2Customer Id,5Company^6City,11Subscription Date-' $WHERE/customers-100.csv"		#30
+    "-H -f '1Index,6City-7Country' -c '6City:@upper' $WHERE/customers-100.csv"		#31
+    "-g 8Industry -a count,sum:9,min:7Founded,max:7Founded,avg:9 $WHERE/organizations-100.csv"		#32
+    "-o json -g 7 -a count,max:1 $WHERE/customers-100.csv"		#33
+    "-f '7Country 1 3,2Customer Id' $WHERE/customers-100.csv"		#34
+    "-H -f 2-4 -c '3:@prefix(f\()@suffix(\))' -c '2/4:@join(\))' $WHERE/customers-100.csv"		#35
 )
 
 hash=(
@@ -40,6 +63,29 @@ hash=(
     "a5069b1a2dfd3789b5545a02fc4d8816"  # 10
     "110b56cf242e43a6995b6ea645e4f822"  # 11
     "b82c5ea896f19fa8402f00d2c86dc08f"  # 12
+    "7e00072b9e7d37e6786b0e3c52b90704"  # 13
+    "21030d2c89b6ba6ebac76d8b9e3bd765"  # 14
+    "f2ed118126712ed0c71b643d93c207f1"  # 15
+    "8040ab1b3431a253e05bfea1fbd6aa56"  # 16
+    "f2ed118126712ed0c71b643d93c207f1"  # 17
+    "695793fb53972160ec1f87d62bd47aab"  # 18
+    "d15f0200f581e93ab412222042f1b1c7"  # 19
+    "f2ed118126712ed0c71b643d93c207f1"  # 20
+    "674c6ab9a1cfa25c785ea79d025d06fc"  # 21
+    "8fdebf9409f799a96e39faa59e2f1a90"  # 22
+    "03e54b73676fd6c790b108a043d456f8"  # 23
+    "0dc0372d13edc93b50ab9b78b58daf06"  # 24
+    "23817bd9eb2c728715f3471992153a72"  # 25
+    "44897845c76b5e696fee62664fdb1fcc"  # 26
+    "b4e8982031b41d83229a2f698cf85d43"  # 27
+    "667966c7c751d35836646f5694082d61"  # 28
+    "b557bd493d72e4a885a49a8d01382431"  # 29
+    "7492e86edaf31d19813bcda083f339d4"  # 30
+    "b0a4fdcd744fa3afc29bfc5551891705"  # 31
+    "dc4a0095f410715dabf94c79de1675cd"  # 32
+    "e0cdea229fbbe3e3aebe264ef8112193"  # 33
+    "08d5e80f57f625d28c1fe0dd0c63a4ef"  # 34
+    "9dcd74b83260e6b5e2b149307c7512a4"  # 35
 )
 
 function show_help()
@@ -0,0 +1 @@
+test.sh
\ No newline at end of file
@@ -0,0 +1,38 @@
+#!/bin/bash
+
+# the heap allocations of csvcut do not depend on the number of rows
+# each case is run on a sample file and on its rows repeated 20 times
+
+WHERE=$(cd "$(dirname "$0")" && pwd)
+CSVCUT="$WHERE/../src/csvcut"
+
+cases=(
+    "-f 1,3-5"
+    "-o json -f 2-"
+    "-o xml"
+    "-r 3+4,1^2,5-"
+    "-o json -r 3,1-2"
+    "-H -f 2-5 -c 2:@upper -c 3/4:@join(-)"
+    "-H -f 3-4,11 -c 3-4/11:plugin:$WHERE/procplugin.so:procplugin"
+)
+
+TMP=$(mktemp)
+(head -1 "$WHERE/customers-100.csv"; for i in $(seq 20); do tail -n +2 "$WHERE/customers-100.csv"; done) > $TMP
+
+RESP=0
+for((i=0;i<${#cases[@]};i++))
+do
+  A=$(LD_PRELOAD="$WHERE/malloccount.so" $CSVCUT ${cases[$i]} "$WHERE/customers-100.csv" 2>&1 >/dev/null | grep '^allocations:')
+  B=$(LD_PRELOAD="$WHERE/malloccount.so" $CSVCUT ${cases[$i]} $TMP 2>&1 >/dev/null | grep '^allocations:')
+  C=$(cat $TMP | LD_PRELOAD="$WHERE/malloccount.so" $CSVCUT ${cases[$i]} 2>&1 >/dev/null | grep '^allocations:')
+  if [ x"$A" == x"" ] || [ x"$A" != x"$B" ] || [ x"$A" != x"$C" ]; then
+    echo "FAIL: csvcut ${cases[$i]}: $A / $B / $C"
+    RESP=1
+  else
+    echo "PASS: csvcut ${cases[$i]}: $A"
+  fi
+done
+
+rm -f $TMP
+
+exit $RESP
@@ -0,0 +1,32 @@
+#!/bin/bash
+
+# the rows read back from -o arrow are the rows of the csv output
+
+WHERE=$(cd "$(dirname "$0")" && pwd)
+CSVCUT="$WHERE/../src/csvcut"
+ARROWREAD="$WHERE/arrowread"
+
+cases=(
+    "-f 1,3-5 $WHERE/customers-100.csv"
+    "-f 2- $WHERE/organizations-100.csv"
+    "-r 3+4,1^2,5- $WHERE/customers-100.csv"
+    "--batch 7 -f 3,1 $WHERE/customers-100.csv"
+    "-j 3 --batch 10 -f 2- $WHERE/organizations-100.csv"
+    "-w 7~^[A-C] -f 2,7 -c 2:@upper $WHERE/customers-100.csv"
+    "-f 1,4 $WHERE/ncca_qa_codes.csv"
+)
+
+RESP=0
+for((i=0;i<${#cases[@]};i++))
+do
+  A=$($CSVCUT -o arrow ${cases[$i]} | $ARROWREAD | md5sum)
+  B=$($CSVCUT -H ${cases[$i]} | md5sum)
+  if [ x"$A" != x"$B" ]; then
+    echo "FAIL: csvcut ${cases[$i]}: $A / $B"
+    RESP=1
+  else
+    echo "PASS: csvcut ${cases[$i]}: $A"
+  fi
+done
+
+exit $RESP
@@ -0,0 +1,53 @@
+#!/bin/bash
+
+# cutting from a column cache gives the same output as cutting the file
+
+WHERE=$(cd "$(dirname "$0")" && pwd)
+CSVCUT="$WHERE/../src/csvcut"
+
+cases=(
+    "-f 1,3-5"
+    "-o json -f 2-"
+    "-o xml"
+    "-r 3+4,1^2,5-"
+    "-H -f 2 -w 1>=50&1<60|3~^[A-C]"
+    "-o json --rows 10-20"
+    "-j 3 -f 3,1 --rows 30-"
+    "-P 2 -H -f 2-3 -c 2:@upper"
+)
+
+TMP=$(mktemp)
+cp "$WHERE/customers-100.csv" $TMP
+
+RESP=0
+for((i=0;i<${#cases[@]};i++))
+do
+  rm -f $TMP.cols
+  A=$($CSVCUT ${cases[$i]} $TMP | md5sum)
+  $CSVCUT --cache $TMP
+  B=$($CSVCUT ${cases[$i]} $TMP | md5sum)
+  if [ ! -s $TMP.cols ] || [ x"$A" != x"$B" ]; then
+    echo "FAIL: csvcut ${cases[$i]}: $A / $B"
+    RESP=1
+  else
+    echo "PASS: csvcut ${cases[$i]}: $A"
+  fi
+done
+
+# a file rewritten in place with the same size within the same second
+printf 'a,b\n1,x\n2,y\n' > $TMP
+touch -d @1700000000.1 $TMP
+$CSVCUT --cache $TMP
+printf 'a,b\n3,z\n4,w\n' > $TMP
+touch -d @1700000000.2 $TMP
+A=$($CSVCUT -H -f 2 $TMP 2>/dev/null)
+if [ x"$A" != x'"z"'$'\n''"w"' ]; then
+  echo "FAIL: csvcut with a cache of a rewritten file: $A"
+  RESP=1
+else
+  echo "PASS: csvcut with a cache of a rewritten file"
+fi
+
+rm -f $TMP $TMP.cols
+
+exit $RESP
@@ -0,0 +1,39 @@
+#!/bin/bash
+
+# gzip input, as a file, as a pipe and as concatenated members, gives the same output as the csv
+# skipped if gzip is missing or csvcut was built without zlib
+
+WHERE=$(cd "$(dirname "$0")" && pwd)
+CSVCUT="$WHERE/../src/csvcut"
+
+which gzip >/dev/null || exit 77
+
+cases=(
+    "-f 1,3-5"
+    "-o json -r 3,1-2"
+    "--rows 10-20 -f 2"
+)
+
+TMP=$(mktemp)
+gzip -c "$WHERE/customers-100.csv" > $TMP
+$CSVCUT $TMP 2>&1 >/dev/null | grep -q "without zlib" && { rm -f $TMP; exit 77; }
+(head -40 "$WHERE/customers-100.csv" | gzip -c; tail -n +41 "$WHERE/customers-100.csv" | gzip -c) > $TMP.2
+
+RESP=0
+for((i=0;i<${#cases[@]};i++))
+do
+  A=$($CSVCUT ${cases[$i]} "$WHERE/customers-100.csv" | md5sum)
+  B=$($CSVCUT ${cases[$i]} $TMP | md5sum)
+  C=$(cat $TMP | $CSVCUT ${cases[$i]} | md5sum)
+  D=$($CSVCUT ${cases[$i]} $TMP.2 | md5sum)
+  if [ x"$A" != x"$B" ] || [ x"$A" != x"$C" ] || [ x"$A" != x"$D" ]; then
+    echo "FAIL: csvcut ${cases[$i]}: $A / $B / $C / $D"
+    RESP=1
+  else
+    echo "PASS: csvcut ${cases[$i]}: $A"
+  fi
+done
+
+rm -f $TMP $TMP.2
+
+exit $RESP
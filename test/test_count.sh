@@ -0,0 +1,45 @@
+#!/bin/bash
+
+# --count gives the same rows, header fields, most fields and longest record
+# with threads, from a pipe and from a compressed file
+
+WHERE=$(cd "$(dirname "$0")" && pwd)
+CSVCUT="$WHERE/../src/csvcut"
+
+# file and the expected counts
+cases=(
+    "customers-100.csv|100 12 12 216"
+    "organizations-100.csv|100 9 9 176"
+    "ncca_qa_codes.csv|56 4 4 244"
+)
+
+TMP=$(mktemp)
+RESP=0
+for((i=0;i<${#cases[@]};i++))
+do
+  f="$WHERE/${cases[$i]%%|*}"
+  expected=${cases[$i]#*|}
+  # the records repeated make several ranges for the threads
+  (cat "$f"; for k in $(seq 20); do tail -n +2 "$f"; done) > $TMP
+  rows=${expected%% *}
+  many="$((rows*21)) ${expected#* }"
+  for args in "" "-j 3" "-j 16"; do
+    A=$($CSVCUT --count $args "$f" | cut -d' ' -f1-4)
+    B=$($CSVCUT --count $args $TMP | cut -d' ' -f1-4)
+    if [ x"$A" != x"$expected" ] || [ x"$B" != x"$many" ]; then
+      echo "FAIL: csvcut --count $args ${cases[$i]%%|*}: $A / $B"
+      RESP=1
+    fi
+  done
+  A=$(cat $TMP | $CSVCUT --count | cut -d' ' -f1-4)
+  B=$(gzip -c $TMP | $CSVCUT --count | cut -d' ' -f1-4)
+  if [ x"$A" != x"$many" ] || [ x"$B" != x"$many" ]; then
+    echo "FAIL: csvcut --count ${cases[$i]%%|*} from a pipe: $A / $B"
+    RESP=1
+  fi
+done
+[ $RESP -eq 0 ] && echo "PASS: csvcut --count"
+
+rm -f $TMP
+
+exit $RESP
@@ -0,0 +1,50 @@
+#!/bin/bash
+
+# -g gives the same groups when they are spilled to temporary files, the counts of the
+# groups add up to the rows of the file and the aggregates of a small file are known
+
+WHERE=$(cd "$(dirname "$0")" && pwd)
+CSVCUT="$WHERE/../src/csvcut"
+
+# file and the -g and -a arguments
+cases=(
+    "customers-100.csv|7Country|count,sum:1,min:1,max:1,avg:1"
+    "organizations-100.csv|5,8|count,sum:9Number of employees,max:7"
+    "ncca_qa_codes.csv|2|count"
+)
+
+TMP=$(mktemp)
+RESP=0
+for((i=0;i<${#cases[@]};i++))
+do
+  IFS='|' read -r f g a <<< "${cases[$i]}"
+  # the records repeated make groups of several rows
+  (cat "$WHERE/$f"; for k in $(seq 20); do tail -n +2 "$WHERE/$f"; done) > $TMP
+  A=$($CSVCUT -H -g "$g" -a "$a" $TMP | sort | md5sum)
+  for mem in 1 1000 10000; do
+    B=$($CSVCUT -H -g "$g" -a "$a" --group-mem $mem $TMP | sort | md5sum)
+    if [ x"$A" != x"$B" ]; then
+      echo "FAIL: csvcut -g $g -a $a --group-mem $mem $f"
+      RESP=1
+    fi
+  done
+  rows=$($CSVCUT --count $TMP | cut -d' ' -f1)
+  n=$($CSVCUT -H -g "$g" -a count $TMP | awk -F'"' '{ n+=$(NF-1) } END { print n }')
+  if [ x"$n" != x"$rows" ]; then
+    echo "FAIL: csvcut -g $g -a count $f: $n rows of $rows"
+    RESP=1
+  fi
+done
+
+# known aggregates, a value that is not a number is skipped
+printf 'k,v\na,1\na,2\nb,x\n' > $TMP
+A=$($CSVCUT -H -g 1 -a count,sum:2,avg:2,min:2,max:2 $TMP)
+if [ x"$A" != x'"a","2","3","1.5","1","2"'$'\n''"b","1","0","","",""' ]; then
+  echo "FAIL: csvcut -g 1 -a count,sum:2,avg:2,min:2,max:2: $A"
+  RESP=1
+fi
+[ $RESP -eq 0 ] && echo "PASS: csvcut -g"
+
+rm -f $TMP
+
+exit $RESP
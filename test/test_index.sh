@@ -0,0 +1,54 @@
+#!/bin/bash
+
+# --rows gives the same rows with and without a sidecar index
+# the sample has quoted fields spanning lines, so the rows are not the lines
+
+WHERE=$(cd "$(dirname "$0")" && pwd)
+CSVCUT="$WHERE/../src/csvcut"
+
+cases=(
+    "--rows 1-3"
+    "--rows 7-9"
+    "--rows 250"
+    "--rows 100-"
+    "-o json --rows 40-400"
+    "-j 3 --rows 2-999"
+    "-j 3 -o json"
+)
+
+TMP=$(mktemp)
+(echo 'id,text,n'; for i in $(seq 1000); do if [ $((i%3)) == 0 ]; then echo "$i,\"line $i"; echo "next, $i\",$i"; else echo "$i,text $i,$i"; fi; done) > $TMP
+
+RESP=0
+for((i=0;i<${#cases[@]};i++))
+do
+  rm -f $TMP.idx
+  A=$($CSVCUT ${cases[$i]} $TMP | md5sum)
+  B=$(cat $TMP | $CSVCUT ${cases[$i]} | md5sum)
+  $CSVCUT --index=7 $TMP
+  C=$($CSVCUT ${cases[$i]} $TMP | md5sum)
+  if [ ! -s $TMP.idx ] || [ x"$A" != x"$B" ] || [ x"$A" != x"$C" ]; then
+    echo "FAIL: csvcut ${cases[$i]}: $A / $B / $C"
+    RESP=1
+  else
+    echo "PASS: csvcut ${cases[$i]}: $A"
+  fi
+done
+
+# a file rewritten in place with the same size within the same second
+(echo 'id,text,n'; for i in $(seq 1000); do echo "$i,text $i,$i"; done) > $TMP
+touch -d @1700000000.1 $TMP
+$CSVCUT --index=7 $TMP
+(echo 'id,text,n'; for i in $(seq 1000 -1 1); do echo "$i,text $i,$i"; done) > $TMP
+touch -d @1700000000.2 $TMP
+A=$($CSVCUT --rows 500-501 $TMP 2>/dev/null)
+if [ x"$A" != x'"id","text","n"'$'\n''"501","text 501","501"'$'\n''"500","text 500","500"' ]; then
+  echo "FAIL: csvcut --rows with an index of a rewritten file: $A"
+  RESP=1
+else
+  echo "PASS: csvcut --rows with an index of a rewritten file"
+fi
+
+rm -f $TMP $TMP.idx
+
+exit $RESP
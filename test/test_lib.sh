@@ -0,0 +1,44 @@
+#!/bin/bash
+
+# rows of libcsvcut fed in small buffers are the rows of csvcut -r
+# the generated file has quoted fields spanning lines and no newline at the end
+
+WHERE=$(cd "$(dirname "$0")" && pwd)
+CSVCUT="$WHERE/../src/csvcut"
+LIBFEED="$WHERE/libfeed"
+
+TMP=$(mktemp)
+(echo 'id,text,n'; for i in $(seq 300); do if [ $((i%3)) == 0 ]; then echo "$i,\"line \"\"$i\"\""; echo "next, $i\",$i"; else echo "$i, text $i ,$i"; fi; done; printf '301,"last",9') > $TMP
+
+cases=(
+    "$WHERE/customers-100.csv"
+    "-s 3,1 $WHERE/customers-100.csv"
+    "-s 4-6,-2,9- $WHERE/organizations-100.csv"
+    "-s 12-,1 -d ; $WHERE/FinancialSample.csv"
+    "$TMP"
+    "-s 3-1,5 $TMP"
+)
+
+RESP=0
+for((i=0;i<${#cases[@]};i++))
+do
+  B=$($CSVCUT $(echo "${cases[$i]}" | sed 's/-s /-r /') | md5sum)
+  for b in 1 13 4096; do
+    A=$($LIBFEED -b $b ${cases[$i]} | md5sum)
+    if [ x"$A" != x"$B" ]; then
+      echo "FAIL: libfeed -b $b ${cases[$i]}: $A / $B"
+      RESP=1
+    else
+      echo "PASS: libfeed -b $b ${cases[$i]}: $A"
+    fi
+  done
+done
+
+# a non-zero return value of the callback stops the parser
+if [ "$($LIBFEED -b 5 -n 7 $WHERE/customers-100.csv)" != "$($CSVCUT $WHERE/customers-100.csv | head -7)" ]; then
+  echo "FAIL: libfeed -n 7"
+  RESP=1
+fi
+rm -f $TMP
+
+exit $RESP
@@ -0,0 +1,33 @@
+#!/bin/bash
+
+# with -J the column names are looked up in the first file whichever file a thread reads first,
+# a name in another column of a later file fails before anything is written
+
+WHERE=$(cd "$(dirname "$0")" && pwd)
+CSVCUT="$WHERE/../src/csvcut"
+
+TMP=$(mktemp -d)
+printf 'a,b\n1,2\n' > $TMP/x1.csv
+printf 'b,a\n3,4\n' > $TMP/x2.csv
+printf 'a,b\n5,6\n' > $TMP/x3.csv
+
+RESP=0
+for((i=0;i<10;i++))
+do
+  A=$($CSVCUT -J 2 -f a $TMP/x1.csv $TMP/x3.csv $TMP/x1.csv | tr '\n' ' ')
+  if [ x"$A" != x'"a" "1" "a" "5" "a" "1" ' ]; then
+    echo "FAIL: csvcut -J 2 -f a: $A"
+    RESP=1
+  fi
+  A=$($CSVCUT -J 2 -f a $TMP/x1.csv $TMP/x2.csv 2>$TMP/err)
+  B=$(cat $TMP/err)
+  if [ x"$A" != x ] || [ x"${B#*: }" != x"$TMP/x2.csv: column 'a' is not field 1 as in the first file" ]; then
+    echo "FAIL: csvcut -J 2 -f a with the name in another column: $A / $B"
+    RESP=1
+  fi
+done
+[ $RESP -eq 0 ] && echo "PASS: csvcut -J 2 -f a"
+
+rm -rf $TMP
+
+exit $RESP
@@ -0,0 +1,39 @@
+#!/bin/bash
+
+# --stats does not change the output and counts the records, rows and callouts
+
+WHERE=$(cd "$(dirname "$0")" && pwd)
+CSVCUT="$WHERE/../src/csvcut"
+CSV="$WHERE/customers-100.csv"
+
+# arguments and a pattern the report has to match
+cases=(
+    "-f 1,3|\"files\":1,\"bytes\":17276,\"records\":101,\"rows\":100,"
+    "-j 3 -f 2-|\"records\":101,\"rows\":100,"
+    "-w 7==Chile -f 1|\"records\":101,\"rows\":1,"
+    "-H -f 2 -c 2:@upper|\"command\":\"@upper\",\"type\":\"builtin\",\"fields\":\[2,2\],\"calls\":100,\"cached\":0,"
+    "-o json -f 1,3 -c 3:$WHERE/procfield|\"type\":\"shell\",\"fields\":\[3,3\],\"calls\":100,"
+    "-J 2 -f 1 $CSV|\"files\":2,\"bytes\":34552,\"records\":202,\"rows\":200,"
+)
+
+TMP=$(mktemp)
+RESP=0
+for((i=0;i<${#cases[@]};i++))
+do
+  args=${cases[$i]%%|*}
+  pattern=${cases[$i]#*|}
+  A=$($CSVCUT $args $CSV | md5sum)
+  B=$($CSVCUT --stats $args $CSV 2>$TMP | md5sum)
+  if [ x"$A" != x"$B" ]; then
+    echo "FAIL: csvcut --stats $args: output $A / $B"
+    RESP=1
+  elif ! tail -1 $TMP | grep -q "$pattern" || ! tail -1 $TMP | grep -q '"stages":{"read":[0-9.]*,"tokenize"'; then
+    echo "FAIL: csvcut --stats $args: report $(tail -1 $TMP)"
+    RESP=1
+  else
+    echo "PASS: csvcut --stats $args"
+  fi
+done
+rm -f $TMP
+
+exit $RESP